@@ -0,0 +1,327 @@
+#include "nek5KSwap.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NEK5K_SWAP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NEK5K_SWAP_NEON
+#include <arm_neon.h>
+#endif
+
+// let GCC and clang compile a function for an instruction set which is not
+// enabled for the whole file; MSVC needs nothing for the intrinsics
+#if defined(__GNUC__) || defined(__clang__)
+#define NEK5K_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NEK5K_TARGET(isa)
+#endif
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Scalar kernels, also used for the tails of the vector loops.
+// The swaps are written with shifts, which compilers turn into bswap.
+inline uint32_t swapBytes32(uint32_t v)
+{
+  return (v >> 24) | ((v >> 8) & 0x0000ff00u) | ((v << 8) & 0x00ff0000u) | (v << 24);
+}
+
+inline uint64_t swapBytes64(uint64_t v)
+{
+  return (uint64_t(swapBytes32(uint32_t(v))) << 32) | swapBytes32(uint32_t(v >> 32));
+}
+
+void swap32Scalar(const char* src, int64_t n, char* dst)
+{
+  uint32_t bits;
+  for(int64_t i = 0; i < n; i++)
+  {
+    memcpy(&bits, src + 4 * i, 4);
+    bits = swapBytes32(bits);
+    memcpy(dst + 4 * i, &bits, 4);
+  }
+}
+
+void swap64Scalar(const char* src, int64_t n, char* dst)
+{
+  uint64_t bits;
+  for(int64_t i = 0; i < n; i++)
+  {
+    memcpy(&bits, src + 8 * i, 8);
+    bits = swapBytes64(bits);
+    memcpy(dst + 8 * i, &bits, 8);
+  }
+}
+
+void narrow64Scalar(const char* src, int64_t n, bool swap, float* dst)
+{
+  uint64_t bits;
+  double value;
+  for(int64_t i = 0; i < n; i++)
+  {
+    memcpy(&bits, src + 8 * i, 8);
+    if(swap)
+      bits = swapBytes64(bits);
+    memcpy(&value, &bits, 8);
+    dst[i] = float(value);
+  }
+}
+
+#ifdef NEK5K_SWAP_X86
+//----------------------------------------------------------------------------
+// SSSE3: 16 bytes per shuffle
+NEK5K_TARGET("ssse3")
+void swap32SSSE3(const char* src, int64_t n, char* dst)
+{
+  const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  int64_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+    _mm_storeu_si128((__m128i*)(dst + 4 * i), _mm_shuffle_epi8(v, mask));
+  }
+  swap32Scalar(src + 4 * i, n - i, dst + 4 * i);
+}
+
+NEK5K_TARGET("ssse3")
+void swap64SSSE3(const char* src, int64_t n, char* dst)
+{
+  const __m128i mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  int64_t i = 0;
+  for(; i + 2 <= n; i += 2)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + 8 * i));
+    _mm_storeu_si128((__m128i*)(dst + 8 * i), _mm_shuffle_epi8(v, mask));
+  }
+  swap64Scalar(src + 8 * i, n - i, dst + 8 * i);
+}
+
+NEK5K_TARGET("ssse3")
+void narrow64SSSE3(const char* src, int64_t n, bool swap, float* dst)
+{
+  const __m128i mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  int64_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    __m128i lo = _mm_loadu_si128((const __m128i*)(src + 8 * i));
+    __m128i hi = _mm_loadu_si128((const __m128i*)(src + 8 * i + 16));
+    if(swap)
+    {
+      lo = _mm_shuffle_epi8(lo, mask);
+      hi = _mm_shuffle_epi8(hi, mask);
+    }
+    __m128 f = _mm_movelh_ps(_mm_cvtpd_ps(_mm_castsi128_pd(lo)), _mm_cvtpd_ps(_mm_castsi128_pd(hi)));
+    _mm_storeu_ps(dst + i, f);
+  }
+  narrow64Scalar(src + 8 * i, n - i, swap, dst + i);
+}
+
+//----------------------------------------------------------------------------
+// AVX2: 32 bytes per shuffle (the byte shuffle works within 16-byte lanes,
+// which is all a swap needs)
+NEK5K_TARGET("avx2")
+void swap32AVX2(const char* src, int64_t n, char* dst)
+{
+  const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  int64_t i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(src + 4 * i));
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i), _mm256_shuffle_epi8(v, mask));
+  }
+  swap32Scalar(src + 4 * i, n - i, dst + 4 * i);
+}
+
+NEK5K_TARGET("avx2")
+void swap64AVX2(const char* src, int64_t n, char* dst)
+{
+  const __m256i mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  int64_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(src + 8 * i));
+    _mm256_storeu_si256((__m256i*)(dst + 8 * i), _mm256_shuffle_epi8(v, mask));
+  }
+  swap64Scalar(src + 8 * i, n - i, dst + 8 * i);
+}
+
+NEK5K_TARGET("avx2")
+void narrow64AVX2(const char* src, int64_t n, bool swap, float* dst)
+{
+  const __m256i mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  int64_t i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    __m256i lo = _mm256_loadu_si256((const __m256i*)(src + 8 * i));
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(src + 8 * i + 32));
+    if(swap)
+    {
+      lo = _mm256_shuffle_epi8(lo, mask);
+      hi = _mm256_shuffle_epi8(hi, mask);
+    }
+    _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_castsi256_pd(lo)));
+    _mm_storeu_ps(dst + i + 4, _mm256_cvtpd_ps(_mm256_castsi256_pd(hi)));
+  }
+  narrow64Scalar(src + 8 * i, n - i, swap, dst + i);
+}
+#endif // NEK5K_SWAP_X86
+
+#ifdef NEK5K_SWAP_NEON
+//----------------------------------------------------------------------------
+// NEON is always there on 64-bit ARM
+void swap32NEON(const char* src, int64_t n, char* dst)
+{
+  int64_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    uint8x16_t v = vld1q_u8((const uint8_t*)(src + 4 * i));
+    vst1q_u8((uint8_t*)(dst + 4 * i), vrev32q_u8(v));
+  }
+  swap32Scalar(src + 4 * i, n - i, dst + 4 * i);
+}
+
+void swap64NEON(const char* src, int64_t n, char* dst)
+{
+  int64_t i = 0;
+  for(; i + 2 <= n; i += 2)
+  {
+    uint8x16_t v = vld1q_u8((const uint8_t*)(src + 8 * i));
+    vst1q_u8((uint8_t*)(dst + 8 * i), vrev64q_u8(v));
+  }
+  swap64Scalar(src + 8 * i, n - i, dst + 8 * i);
+}
+
+void narrow64NEON(const char* src, int64_t n, bool swap, float* dst)
+{
+  int64_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    uint8x16_t lo = vld1q_u8((const uint8_t*)(src + 8 * i));
+    uint8x16_t hi = vld1q_u8((const uint8_t*)(src + 8 * i + 16));
+    if(swap)
+    {
+      lo = vrev64q_u8(lo);
+      hi = vrev64q_u8(hi);
+    }
+    float32x4_t f = vcombine_f32(vcvt_f32_f64(vreinterpretq_f64_u8(lo)), vcvt_f32_f64(vreinterpretq_f64_u8(hi)));
+    vst1q_f32(dst + i, f);
+  }
+  narrow64Scalar(src + 8 * i, n - i, swap, dst + i);
+}
+#endif // NEK5K_SWAP_NEON
+
+//----------------------------------------------------------------------------
+struct nek5KSwapKernels
+{
+  void (*swap32)(const char* src, int64_t n, char* dst);
+  void (*swap64)(const char* src, int64_t n, char* dst);
+  void (*narrow64)(const char* src, int64_t n, bool swap, float* dst);
+  const char* name;
+};
+
+nek5KSwapKernels selectKernels()
+{
+#if defined(NEK5K_SWAP_X86)
+  bool ssse3, avx2;
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  int max_leaf = info[0];
+  __cpuid(info, 1);
+  ssse3 = (info[2] & (1 << 9)) != 0;
+  // AVX2 also needs the OS to save the ymm registers
+  bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+  avx2 = false;
+  if(max_leaf >= 7 && os_avx)
+  {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#else
+  __builtin_cpu_init();
+  ssse3 = __builtin_cpu_supports("ssse3");
+  avx2 = __builtin_cpu_supports("avx2");
+#endif
+  if(avx2)
+    return { swap32AVX2, swap64AVX2, narrow64AVX2, "AVX2" };
+  if(ssse3)
+    return { swap32SSSE3, swap64SSSE3, narrow64SSSE3, "SSSE3" };
+#elif defined(NEK5K_SWAP_NEON)
+  return { swap32NEON, swap64NEON, narrow64NEON, "NEON" };
+#endif
+  return { swap32Scalar, swap64Scalar, narrow64Scalar, "scalar" };
+}
+
+const nek5KSwapKernels& kernels()
+{
+  static const nek5KSwapKernels selected = selectKernels();
+  return selected;
+}
+
+} // anonymous namespace
+
+//----------------------------------------------------------------------------
+void ByteSwap32(void *aVals, int64_t nVals)
+{
+  kernels().swap32((const char*)aVals, nVals, (char*)aVals);
+}
+
+void ByteSwap64(void *aVals, int64_t nVals)
+{
+  kernels().swap64((const char*)aVals, nVals, (char*)aVals);
+}
+
+//----------------------------------------------------------------------------
+void nek5KConvertValues(const char* src, int64_t n, int precision, bool swap, float* dst)
+{
+  if(precision == 8)
+  {
+    kernels().narrow64(src, n, swap, dst);
+  }
+  else if(swap)
+  {
+    kernels().swap32(src, n, (char*)dst);
+  }
+  else if(src != (const char*)dst)
+  {
+    memcpy(dst, src, n * sizeof(float));
+  }
+}
+
+void nek5KConvertValues(const char* src, int64_t n, int precision, bool swap, double* dst)
+{
+  if(precision == 8)
+  {
+    if(swap)
+      kernels().swap64(src, n, (char*)dst);
+    else if(src != (const char*)dst)
+      memcpy(dst, src, n * sizeof(double));
+    return;
+  }
+
+  // 4-byte values are not read as double by the reader, but are handled
+  uint32_t bits;
+  float value;
+  for(int64_t i = 0; i < n; i++)
+  {
+    memcpy(&bits, src + 4 * i, 4);
+    if(swap)
+      bits = swapBytes32(bits);
+    memcpy(&value, &bits, 4);
+    dst[i] = value;
+  }
+}
+
+const char* nek5KSwapKernelName()
+{
+  return kernels().name;
+}
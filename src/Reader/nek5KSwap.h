@@ -0,0 +1,25 @@
+// Byte swapping and conversion of the values of Nek5000 files.
+//
+// The kernels use SSSE3 or AVX2 shuffles on x86, picked at run time from
+// what the CPU supports, NEON on 64-bit ARM, and plain loops otherwise.
+// Counts are 64-bit, sources may be unaligned.
+
+#ifndef __nek5KSwap_h
+#define __nek5KSwap_h
+
+#include <cstdint>
+
+// swap the bytes of 'nVals' 4-byte or 8-byte values in place
+void ByteSwap32(void *aVals, int64_t nVals);
+void ByteSwap64(void *aVals, int64_t nVals);
+
+// Convert 'n' values of 'precision' (4 or 8) bytes at 'src' to float or
+// double in a single pass, swapping their bytes first if 'swap'. 'src' may
+// be 'dst' if the values are of the same size.
+void nek5KConvertValues(const char* src, int64_t n, int precision, bool swap, float* dst);
+void nek5KConvertValues(const char* src, int64_t n, int precision, bool swap, double* dst);
+
+// name of the kernels in use: "AVX2", "SSSE3", "NEON" or "scalar"
+const char* nek5KSwapKernelName();
+
+#endif
@@ -0,0 +1,127 @@
+// .NAME vtkNek5000BlockedArray - data array in the per-element layout of Nek5000 files
+// .SECTION Description
+// Nek5000 stores the components of a vector one spectral element at a time:
+// all X values of the element, then all Y values, then all Z values.
+// vtkNek5000BlockedArray presents such a buffer as a regular multi-component
+// array, without reordering it. Tuple t is point t%BlockSize of block
+// t/BlockSize, and its component c is found at
+//   ((t/BlockSize) * NumberOfComponents + c) * BlockSize + t%BlockSize
+// With a BlockSize of 1, this is the usual array-of-structs layout, which is
+// what NewInstance() gives to filters building arrays like this one.
+
+#ifndef __vtkNek5000BlockedArray_h
+#define __vtkNek5000BlockedArray_h
+
+#include "vtkGenericDataArray.h"
+
+template <class ValueTypeT>
+class vtkNek5000BlockedArray
+  : public vtkGenericDataArray<vtkNek5000BlockedArray<ValueTypeT>, ValueTypeT>
+{
+  typedef vtkGenericDataArray<vtkNek5000BlockedArray<ValueTypeT>, ValueTypeT> GenericDataArrayType;
+
+ public:
+  typedef vtkNek5000BlockedArray<ValueTypeT> SelfType;
+  vtkTemplateTypeMacro(SelfType, GenericDataArrayType);
+  typedef typename Superclass::ValueType ValueType;
+
+  static vtkNek5000BlockedArray* New();
+
+  // Description:
+  // Set/Get the number of tuples stored in a block (the number of points of
+  // a spectral element). Set it before allocating or setting the data.
+  void SetBlockSize(vtkIdType size);
+  vtkIdType GetBlockSize() const { return this->BlockSize; }
+
+  // Description:
+  // Use 'array', holding 'numTuples' tuples in the blocked layout, without
+  // copying it. It is released with 'freeFunction', or never if nullptr.
+  void SetArray(ValueType* array, vtkIdType numTuples, void (*freeFunction)(void*));
+
+  // Description:
+  // Direct access to the storage, in the blocked layout.
+  ValueType* GetBlockedData() { return this->Data; }
+
+  inline ValueType GetValue(vtkIdType valueIdx) const
+  {
+    vtkIdType tupleIdx = valueIdx / this->NumberOfComponents;
+    return this->Data[this->GetStorageIndex(tupleIdx, int(valueIdx - tupleIdx * this->NumberOfComponents))];
+  }
+
+  inline void SetValue(vtkIdType valueIdx, ValueType value)
+  {
+    vtkIdType tupleIdx = valueIdx / this->NumberOfComponents;
+    this->Data[this->GetStorageIndex(tupleIdx, int(valueIdx - tupleIdx * this->NumberOfComponents))] = value;
+  }
+
+  inline void GetTypedTuple(vtkIdType tupleIdx, ValueType* tuple) const
+  {
+    const ValueType* ptr = this->Data + this->GetStorageIndex(tupleIdx, 0);
+    for (int c = 0; c < this->NumberOfComponents; ++c)
+    {
+      tuple[c] = ptr[c * this->BlockSize];
+    }
+  }
+
+  inline void SetTypedTuple(vtkIdType tupleIdx, const ValueType* tuple)
+  {
+    ValueType* ptr = this->Data + this->GetStorageIndex(tupleIdx, 0);
+    for (int c = 0; c < this->NumberOfComponents; ++c)
+    {
+      ptr[c * this->BlockSize] = tuple[c];
+    }
+  }
+
+  inline ValueType GetTypedComponent(vtkIdType tupleIdx, int comp) const
+  {
+    return this->Data[this->GetStorageIndex(tupleIdx, comp)];
+  }
+
+  inline void SetTypedComponent(vtkIdType tupleIdx, int comp, ValueType value)
+  {
+    this->Data[this->GetStorageIndex(tupleIdx, comp)] = value;
+  }
+
+  // Description:
+  // Legacy code needs the array-of-structs layout: unless the blocked layout
+  // is already that one, it gets a copy, valid until the next call.
+  void* GetVoidPointer(vtkIdType valueIdx) override;
+
+ protected:
+  vtkNek5000BlockedArray();
+  ~vtkNek5000BlockedArray() override;
+
+  inline vtkIdType GetStorageIndex(vtkIdType tupleIdx, int comp) const
+  {
+    vtkIdType block = tupleIdx / this->BlockSize;
+    return (block * this->NumberOfComponents + comp) * this->BlockSize + (tupleIdx - block * this->BlockSize);
+  }
+
+  // Description:
+  // Allocate space for numTuples. Old data is not preserved.
+  bool AllocateTuples(vtkIdType numTuples);
+
+  // Description:
+  // Allocate space for numTuples. Old data is preserved: since the position
+  // of a tuple does not depend on the size of the array, the blocks are kept
+  // as they are.
+  bool ReallocateTuples(vtkIdType numTuples);
+
+  void ReleaseData();
+
+  ValueType* Data;
+  vtkIdType BlockSize;
+  vtkIdType NumberOfBlocks; // allocated blocks
+  void (*FreeFunction)(void*);
+  ValueType* AoSCopy; // returned by GetVoidPointer()
+
+ private:
+  vtkNek5000BlockedArray(const vtkNek5000BlockedArray&) = delete;
+  void operator=(const vtkNek5000BlockedArray&) = delete;
+
+  friend class vtkGenericDataArray<vtkNek5000BlockedArray<ValueTypeT>, ValueTypeT>;
+};
+
+#include "vtkNek5000BlockedArray.txx"
+
+#endif
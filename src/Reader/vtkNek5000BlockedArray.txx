@@ -0,0 +1,155 @@
+#ifndef __vtkNek5000BlockedArray_txx
+#define __vtkNek5000BlockedArray_txx
+
+#include "vtkNek5000BlockedArray.h"
+
+#include "vtkObjectFactory.h"
+
+#include <cstdlib>
+#include <cstring>
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+vtkNek5000BlockedArray<ValueType>* vtkNek5000BlockedArray<ValueType>::New()
+{
+  VTK_STANDARD_NEW_BODY(vtkNek5000BlockedArray<ValueType>);
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+vtkNek5000BlockedArray<ValueType>::vtkNek5000BlockedArray()
+{
+  this->Data = nullptr;
+  this->BlockSize = 1;
+  this->NumberOfBlocks = 0;
+  this->FreeFunction = nullptr;
+  this->AoSCopy = nullptr;
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+vtkNek5000BlockedArray<ValueType>::~vtkNek5000BlockedArray()
+{
+  this->ReleaseData();
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+void vtkNek5000BlockedArray<ValueType>::ReleaseData()
+{
+  if (this->Data && this->FreeFunction)
+  {
+    this->FreeFunction(this->Data);
+  }
+  this->Data = nullptr;
+  this->FreeFunction = nullptr;
+  this->NumberOfBlocks = 0;
+  free(this->AoSCopy);
+  this->AoSCopy = nullptr;
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+void vtkNek5000BlockedArray<ValueType>::SetBlockSize(vtkIdType size)
+{
+  if (size < 1 || size == this->BlockSize)
+  {
+    return;
+  }
+  // the data in place would be scrambled
+  this->Initialize();
+  this->ReleaseData();
+  this->BlockSize = size;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+void vtkNek5000BlockedArray<ValueType>::SetArray(
+  ValueType* array, vtkIdType numTuples, void (*freeFunction)(void*))
+{
+  this->ReleaseData();
+  this->Data = array;
+  this->FreeFunction = freeFunction;
+  this->NumberOfBlocks = (numTuples + this->BlockSize - 1) / this->BlockSize;
+  this->Size = this->NumberOfBlocks * this->BlockSize * this->NumberOfComponents;
+  this->MaxId = numTuples * this->NumberOfComponents - 1;
+  this->DataChanged();
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+void* vtkNek5000BlockedArray<ValueType>::GetVoidPointer(vtkIdType valueIdx)
+{
+  if (this->BlockSize == 1 || this->NumberOfComponents == 1)
+  {
+    return this->Data + valueIdx;
+  }
+
+  vtkDebugMacro(<< "GetVoidPointer called: exporting the blocked layout to a copy");
+  vtkIdType numValues = this->GetNumberOfValues();
+  free(this->AoSCopy);
+  this->AoSCopy = static_cast<ValueType*>(malloc(numValues * sizeof(ValueType) + 1));
+  if (!this->AoSCopy)
+  {
+    vtkErrorMacro(<< "Unable to allocate " << numValues << " values for the exported copy.");
+    return nullptr;
+  }
+  vtkIdType numTuples = this->GetNumberOfTuples();
+  for (vtkIdType t = 0; t < numTuples; ++t)
+  {
+    this->GetTypedTuple(t, this->AoSCopy + t * this->NumberOfComponents);
+  }
+  return this->AoSCopy + valueIdx;
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+bool vtkNek5000BlockedArray<ValueType>::AllocateTuples(vtkIdType numTuples)
+{
+  this->ReleaseData();
+  return this->ReallocateTuples(numTuples);
+}
+
+//----------------------------------------------------------------------------
+template <class ValueType>
+bool vtkNek5000BlockedArray<ValueType>::ReallocateTuples(vtkIdType numTuples)
+{
+  vtkIdType numBlocks = (numTuples + this->BlockSize - 1) / this->BlockSize;
+  if (numBlocks == this->NumberOfBlocks)
+  {
+    return true;
+  }
+  size_t blockBytes = this->BlockSize * this->NumberOfComponents * sizeof(ValueType);
+
+  ValueType* data;
+  if (this->FreeFunction == free || this->Data == nullptr)
+  {
+    data = static_cast<ValueType*>(realloc(this->Data, numBlocks * blockBytes + 1));
+    if (!data)
+    {
+      return false;
+    }
+  }
+  else
+  {
+    // storage owned by someone else (e.g. a file mapping): move the blocks
+    data = static_cast<ValueType*>(malloc(numBlocks * blockBytes + 1));
+    if (!data)
+    {
+      return false;
+    }
+    vtkIdType keep = numBlocks < this->NumberOfBlocks ? numBlocks : this->NumberOfBlocks;
+    memcpy(data, this->Data, keep * blockBytes);
+    if (this->FreeFunction)
+    {
+      this->FreeFunction(this->Data);
+    }
+  }
+  this->Data = data;
+  this->FreeFunction = free;
+  this->NumberOfBlocks = numBlocks;
+  return true;
+}
+
+#endif
@@ -3,32 +3,62 @@
 #include "vtkCellArray.h"
 #include "vtkCellData.h"
 #include "vtkCellType.h"
-#include "vtkCleanUnstructuredGrid.h"
+#include "vtkCommunicator.h"
+#include "vtkAOSDataArrayTemplate.h"
 #include "vtkDataArraySelection.h"
+#include "vtkDoubleArray.h"
 #include "vtkFloatArray.h"
+#include "vtkHigherOrderHexahedron.h"
+#include "vtkHigherOrderQuadrilateral.h"
 #include "vtkIdTypeArray.h"
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
 #include "vtkMultiProcessController.h"
+#include "vtkNek5000BlockedArray.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
+#include "vtkPartitionedDataSet.h"
 #include "vtkPointData.h"
+#include "vtkSMPTools.h"
 #include "vtkSmartPointer.h"
 #include "vtkStreamingDemandDrivenPipeline.h"
+#include "vtkStructuredGrid.h"
 #include "vtkTimerLog.h"
+#include "vtkTypeInt32Array.h"
+#include "vtkTypeInt64Array.h"
+#include "vtkTypeTraits.h"
 #include "vtkTypeUInt32Array.h"
 #include "vtkUnsignedCharArray.h"
 #include "vtkUnstructuredGrid.h"
+#include "vtkWeakPointer.h"
+#include "vtk_mpi.h"
+#include "nek5KSwap.h"
 #include <vtksys/SystemTools.hxx>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <new>
+#include <set>
+#include <sstream>
 #include <string>
 
-vtkStandardNewMacro(vtkNek5000Reader);
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-void ByteSwap32(void *aVals, int nVals);
-void ByteSwap64(void *aVals, int nVals);
-int compare_ids(const void *id1, const void *id2);
+// upper bound of the buffer used to stage runs of blocks which cannot be
+// read in place
+#define MAX_STAGING_BYTES (64L*1024L*1024L)
+
+vtkStandardNewMacro(vtkNek5000Reader);
 
 //----------------------------------------------------------------------------
 
@@ -57,6 +87,7 @@ vtkNek5000Reader::vtkNek5000Reader(){
   this->TimeStepRange[0] = 0;
   this->TimeStepRange[1] = 0;
   this->NumberOfTimeSteps = 0;
+  this->datafile_num_steps = 0;
   this->displayed_step = -1;
   this->memory_step = -1;
   this->requested_step = -1;
@@ -64,8 +95,8 @@ vtkNek5000Reader::vtkNek5000Reader(){
   this->num_vars = 0;
   this->var_names = nullptr;
   this->var_length = nullptr;
-  this->dataArray = nullptr;
   this->meshCoords = nullptr;
+  this->dataType = VTK_FLOAT;
   this->myBlockIDs = nullptr;
   this->myBlockPositions = nullptr;
   this->use_variable = nullptr;
@@ -74,15 +105,70 @@ vtkNek5000Reader::vtkNek5000Reader(){
   this->velocity_index = -1;
   this->SpectralElementIds = 0;
   this->CleanGrid = 0;
+  this->UseMemoryMap = 0;
+  this->BlockedVectors = 0;
+  this->DoublePrecision = 0;
+  this->NumberOfReadRequests = 0;
+  this->NumberOfBytesRead = 0;
+  this->NumberOfPerElementReadRequests = 0;
+  this->PrefetchDepth = 0;
+  this->PrefetchDirection = 0;
+  this->UseMPIIO = 0;
+  this->FastOpen = 0;
+  this->NumberOfPrefetchHits = 0;
+  this->NumberOfPrefetchMisses = 0;
+  this->prefetchQuit = false;
+  this->previous_step = -1;
 
   this->PointDataArraySelection = vtkDataArraySelection::New();
 
-  this->myList = new nek5KList();
+  this->CacheSize = 1024;
+  this->GeometryCache = 0;
+  this->LowMemory = 0;
+  this->HighOrderCells = 0;
+  this->StructuredOutput = 0;
+  this->ElementStride = 1;
+  this->element_stride = 1;
+  this->ProjectionOrder = 0;
+  this->projection_order = 0;
+  this->RegionOfInterest = 0;
+  for(int i=0; i<3; i++)
+  {
+    this->RegionBounds[2*i] = -1.0;
+    this->RegionBounds[2*i+1] = 1.0;
+    this->RegionOrigin[i] = 0.0;
+    this->RegionNormal[i] = (i == 0) ? 1.0 : 0.0;
+  }
+  this->RegionThickness = 0.0;
+  this->ValueOfInterest = 0;
+  this->ValueArrayName = nullptr;
+  this->ValueRange[0] = 0.0;
+  this->ValueRange[1] = 0.0;
+  this->high_order_cells = false;
+  this->mergedPoints = nullptr;
+  this->mergedCells = nullptr;
+  this->merged_points_hash = 0;
+  this->PeakMemoryBytes = 0;
+  this->geometryPoints = nullptr;
+  this->geometry_saved = false;
+  this->myCache = new nek5KCache();
 }
 
 //----------------------------------------------------------------------------
 vtkNek5000Reader::~vtkNek5000Reader()
 {
+  // stop reading ahead before anything goes away
+  this->discardPrefetchedSteps();
+  if(this->prefetchThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->prefetchMutex);
+      this->prefetchQuit = true;
+    }
+    this->prefetchCondition.notify_all();
+    this->prefetchThread.join();
+  }
+
   if(this->use_variable)
     delete [] this->use_variable;
   if(this->timestep_has_mesh)
@@ -91,25 +177,21 @@ vtkNek5000Reader::~vtkNek5000Reader()
     delete [] this->FileName;
   if(this->DataFileName)
     delete [] this->DataFileName;
+  if(this->ValueArrayName)
+    delete [] this->ValueArrayName;
 
-  if (this->myList)
+  if (this->myCache)
   {
-    delete this->myList;
+    delete this->myCache;
   }
       
-  if(this->dataArray)
-  {
-    vtkDebugMacro(<<"~vtkNek5000Reader():: Release memory for dataArrays");
-
-    for(auto i=0; i<this->num_vars; i++)
-    {
-      if(this->dataArray[i])
-      {
-        delete [] this->dataArray[i];
-      }
-    }
-    delete [] this->dataArray;
-  }
+  vtkDebugMacro(<<"~vtkNek5000Reader():: Release memory for dataArrays");
+  this->releaseDataArrays();
+  if(this->meshCoords)
+    this->meshCoords->Delete();
+  if(this->geometryPoints)
+    this->geometryPoints->Delete();
+  this->releaseMergedPoints();
 
   if(this->num_vars>0)
   {
@@ -141,19 +223,488 @@ vtkNek5000Reader::~vtkNek5000Reader()
 
 //----------------------------------------------------------------------------
 
-void vtkNek5000Reader::GetAllTimesAndVariableNames(vtkInformationVector *outputVector)
+// Parse the ASCII header of a data file for the time of the step, and the
+// variable tags which tell if the mesh is in the file.
+static bool readStepHeader(const char* dfName, double& time, char tags[32])
 {
   std::ifstream dfPtr;
   char dummy[64];
-  double t;
-  int    c;
-  string v;
+  int c;
+
+  dfPtr.open(dfName);
+  if ( (dfPtr.rdstate() & std::ifstream::failbit ) != 0 )
+  {
+    std::cerr << "Error opening : " << dfName << endl;
+    return false;
+  }
+
+  dfPtr >> dummy >> dummy >> dummy >> dummy >> dummy >> dummy >> dummy;
+  dfPtr >> time >> c >> dummy;
+  //I do this to skip the num directories token, because it may abut
+  //the field tags without a whitespace separator.
+  while (dfPtr.peek() == ' ')
+      dfPtr.get();
+  while (dfPtr.peek() >= '0' && dfPtr.peek() <= '9')
+      dfPtr.get();
+
+  dfPtr.read(tags, 32);
+  tags[31] = '\0';
+  dfPtr.close();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// FNV-1a hash of 'size' bytes, continuing 'hash'
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for(size_t i=0; i<size; i++)
+  {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// the closest float below or above 'value', to keep bounds and ranges in floats
+static float floatBelow(double value)
+{
+  float f = static_cast<float>(value);
+  return (f > value) ? std::nextafter(f, -std::numeric_limits<float>::max()) : f;
+}
+
+static float floatAbove(double value)
+{
+  float f = static_cast<float>(value);
+  return (f < value) ? std::nextafter(f, std::numeric_limits<float>::max()) : f;
+}
+
+// the partition file of a dataset: its .nek5000 file with the extension .map
+static std::string partitionMapName(const char* filename)
+{
+  std::string name(filename);
+  size_t dot = name.rfind('.');
+  return (dot == std::string::npos ? name : name.substr(0, dot)) + ".map";
+}
+
+//----------------------------------------------------------------------------
+// The index file keeps what scanTimeSteps() found in the headers of the data
+// files, with their modification times and sizes: a step whose file did not
+// change since the index was written is not parsed again. The times are in
+// nanoseconds where the file system has them, so that a file rewritten within
+// the same second is seen as changed.
+#define NEK5K_INDEX_MAGIC "NEK5KIDX"
+#define NEK5K_INDEX_VERSION 2
+
+struct nek5KIndexEntry
+{
+  int64_t mtime;
+  int64_t size;
+  double time;
+  int32_t has_mesh;
+};
+
+// the modification time and size of a file, false if it cannot be stat'ed
+static bool fileStamp(const char* filename, int64_t& mtime, int64_t& size)
+{
+#ifndef _WIN32
+  struct stat st;
+  if(stat(filename, &st) != 0)
+    return false;
+#if defined(__APPLE__)
+  mtime = int64_t(st.st_mtimespec.tv_sec)*1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  mtime = int64_t(st.st_mtim.tv_sec)*1000000000 + st.st_mtim.tv_nsec;
+#endif
+  size = int64_t(st.st_size);
+  return true;
+#else
+  if(!vtksys::SystemTools::FileExists(filename, true))
+    return false;
+  mtime = vtksys::SystemTools::ModifiedTime(filename);
+  size = int64_t(vtksys::SystemTools::FileLength(filename));
+  return true;
+#endif
+}
+
+static bool loadTimeIndex(const std::string& indexName, const std::string& format, int start,
+                          char firstTags[32], std::vector<nek5KIndexEntry>& entries)
+{
+  std::ifstream in(indexName.c_str(), std::ifstream::binary);
+  if(!in.is_open())
+    return false;
+
+  char magic[8];
+  int32_t version = 0, num_steps = 0, format_length = 0, file_start = 0;
+  in.read(magic, 8);
+  in.read((char*)&version, 4);
+  in.read((char*)&format_length, 4);
+  if(!in || memcmp(magic, NEK5K_INDEX_MAGIC, 8) != 0 || version != NEK5K_INDEX_VERSION ||
+     format_length != int32_t(format.size()))
+    return false;
+  std::string file_format(format_length, ' ');
+  in.read(&file_format[0], format_length);
+  in.read((char*)&file_start, 4);
+  in.read((char*)&num_steps, 4);
+  in.read(firstTags, 32);
+  if(!in || file_format != format || file_start != start || num_steps < 0)
+    return false;
+
+  entries.resize(num_steps);
+  for(nek5KIndexEntry& entry : entries)
+  {
+    in.read((char*)&entry.mtime, 8);
+    in.read((char*)&entry.size, 8);
+    in.read((char*)&entry.time, 8);
+    in.read((char*)&entry.has_mesh, 4);
+  }
+  return bool(in);
+}
+
+static void saveTimeIndex(const std::string& indexName, const std::string& format, int start,
+                          const char firstTags[32], const std::vector<nek5KIndexEntry>& entries)
+{
+  // written aside, then renamed, so that it is never seen half written
+  std::string tmpName = indexName + ".tmp";
+  std::ofstream out(tmpName.c_str(), std::ofstream::binary);
+  if(!out.is_open())
+    return; // no index in read-only directories
+
+  int32_t version = NEK5K_INDEX_VERSION;
+  int32_t format_length = int32_t(format.size());
+  int32_t file_start = start;
+  int32_t num_steps = int32_t(entries.size());
+  out.write(NEK5K_INDEX_MAGIC, 8);
+  out.write((const char*)&version, 4);
+  out.write((const char*)&format_length, 4);
+  out.write(format.c_str(), format_length);
+  out.write((const char*)&file_start, 4);
+  out.write((const char*)&num_steps, 4);
+  out.write(firstTags, 32);
+  for(const nek5KIndexEntry& entry : entries)
+  {
+    out.write((const char*)&entry.mtime, 8);
+    out.write((const char*)&entry.size, 8);
+    out.write((const char*)&entry.time, 8);
+    out.write((const char*)&entry.has_mesh, 4);
+  }
+  out.close();
+  if(!out || std::rename(tmpName.c_str(), indexName.c_str()) != 0)
+    std::remove(tmpName.c_str());
+}
+
+//----------------------------------------------------------------------------
+// The bounds file keeps the bounds of the points of each element of the first
+// mesh, in the order of the elements in the data files, as six floats rounded
+// outwards. It is used as long as the data file of the mesh keeps the
+// modification time and size it had when the bounds were written.
+#define NEK5K_BOUNDS_MAGIC "NEK5KBND"
+#define NEK5K_BOUNDS_VERSION 2
+
+static bool loadElementBounds(const std::string& boundsName, int num_blocks, int64_t mesh_mtime,
+                              int64_t mesh_size, std::vector<float>& bounds)
+{
+  std::ifstream in(boundsName.c_str(), std::ifstream::binary);
+  if(!in.is_open())
+    return false;
+
+  char magic[8];
+  int32_t version = 0, file_blocks = 0;
+  int64_t file_mtime = 0, file_size = 0;
+  in.read(magic, 8);
+  in.read((char*)&version, 4);
+  in.read((char*)&file_blocks, 4);
+  in.read((char*)&file_mtime, 8);
+  in.read((char*)&file_size, 8);
+  if(!in || memcmp(magic, NEK5K_BOUNDS_MAGIC, 8) != 0 || version != NEK5K_BOUNDS_VERSION ||
+     file_blocks != num_blocks || file_mtime != mesh_mtime || file_size != mesh_size)
+    return false;
+
+  bounds.resize(6 * size_t(num_blocks));
+  in.read((char*)bounds.data(), bounds.size() * sizeof(float));
+  if(!in)
+  {
+    bounds.clear();
+    return false;
+  }
+  return true;
+}
+
+static void saveElementBounds(const std::string& boundsName, int num_blocks, int64_t mesh_mtime,
+                              int64_t mesh_size, const std::vector<float>& bounds)
+{
+  // written aside, then renamed, so that it is never seen half written
+  std::string tmpName = boundsName + ".tmp";
+  std::ofstream out(tmpName.c_str(), std::ofstream::binary);
+  if(!out.is_open())
+    return; // no bounds file in read-only directories
+
+  int32_t version = NEK5K_BOUNDS_VERSION;
+  int32_t file_blocks = num_blocks;
+  out.write(NEK5K_BOUNDS_MAGIC, 8);
+  out.write((const char*)&version, 4);
+  out.write((const char*)&file_blocks, 4);
+  out.write((const char*)&mesh_mtime, 8);
+  out.write((const char*)&mesh_size, 8);
+  out.write((const char*)bounds.data(), bounds.size() * sizeof(float));
+  out.close();
+  if(!out || std::rename(tmpName.c_str(), boundsName.c_str()) != 0)
+    std::remove(tmpName.c_str());
+}
+
+//----------------------------------------------------------------------------
+// The geometry cache file of a rank holds the grid built for its elements:
+// the points of the first mesh, the offsets and connectivity of the cells,
+// and their types, each section aligned on 8 bytes after this header. It is
+// only used with the same number of ranks, the same elements on this rank,
+// and if neither the data file of the mesh nor the .map file changed since.
+#define NEK5K_GEOMETRY_MAGIC "NEK5KGEO"
+#define NEK5K_GEOMETRY_VERSION 3
+
+struct nek5KGeometryHeader
+{
+  char magic[8];
+  int32_t version;
+  int32_t num_ranks;
+  uint64_t partition_hash; // of the dimensions and file positions of my elements
+  int64_t mesh_mtime;      // of the data file the points were read from, in ns
+  int64_t mesh_size;       // of the data file the points were read from
+  int64_t map_mtime;       // of the .map file in ns, 0 if there is none
+  int64_t map_size;        // of the .map file, 0 if there is none
+  int32_t points_type;     // VTK_FLOAT or VTK_DOUBLE
+  int32_t ids_64bit;       // offsets and connectivity are 64-bit integers, otherwise 32-bit
+  int32_t cell_type;       // of all cells: linear or Lagrange hexahedra or quads
+  int32_t reserved;
+  int64_t num_points;
+  int64_t num_cells;
+  int64_t connectivity_size;
+};
+
+static int64_t alignedSize(int64_t size)
+{
+  return (size + 7) & ~int64_t(7);
+}
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Geometry shared by the readers of the process. The cells of a partition only
+// depend on the number and dimensions of its elements; the points of a mesh
+// are found by the data file they come from, or by their values. The entries
+// are weak references, which expire with the last grid using them.
+struct nek5KSharedCells
+{
+  vtkWeakPointer<vtkCellArray> cells;
+  vtkWeakPointer<vtkUnsignedCharArray> types;
+};
+struct nek5KSharedPoints
+{
+  std::string source; // data file, modification time, partition and type
+  size_t hash;
+  vtkWeakPointer<vtkPoints> points;
+};
+std::mutex& sharedGeometryMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+std::map<std::string, nek5KSharedCells>& sharedCells()
+{
+  static auto cells = new std::map<std::string, nek5KSharedCells>;
+  return *cells;
+}
+std::list<nek5KSharedPoints>& sharedPoints()
+{
+  static auto points = new std::list<nek5KSharedPoints>;
+  return *points;
+}
+
+// The pointers into the points and arrays of the steps handed out by
+// aliasBlock(), with the array each one points into, kept alive until
+// releaseAlias() is called with it.
+std::mutex& aliasedArraysMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+std::multimap<void*, vtkSmartPointer<vtkDataArray>>& aliasedArrays()
+{
+  static auto arrays = new std::multimap<void*, vtkSmartPointer<vtkDataArray>>;
+  return *arrays;
+}
+void* shareAlias(vtkDataArray* array, void* ptr)
+{
+  std::lock_guard<std::mutex> lock(aliasedArraysMutex());
+  aliasedArrays().emplace(ptr, array);
+  return ptr;
+}
+void releaseAlias(void* ptr)
+{
+  std::lock_guard<std::mutex> lock(aliasedArraysMutex());
+  auto it = aliasedArrays().find(ptr);
+  if(it != aliasedArrays().end())
+    aliasedArrays().erase(it);
+}
+
+// A new array of the 'block_size' tuples of block 'block' of 'array', which
+// uses its values in place. The blocks of vectors kept in the layout of the
+// files are blocked arrays of one block.
+template <class T>
+vtkDataArray* aliasBlock(vtkDataArray* array, vtkIdType block, vtkIdType block_size)
+{
+  int num_comps = array->GetNumberOfComponents();
+  vtkIdType first = block * block_size * num_comps;
+  vtkDataArray* alias;
+  if(vtkNek5000BlockedArray<T>* blocked = vtkNek5000BlockedArray<T>::SafeDownCast(array))
+  {
+    vtkNek5000BlockedArray<T>* piece = vtkNek5000BlockedArray<T>::New();
+    piece->SetBlockSize(block_size);
+    piece->SetNumberOfComponents(num_comps);
+    piece->SetArray((T*)shareAlias(array, blocked->GetBlockedData() + first), block_size, releaseAlias);
+    alias = piece;
+  }
+  else if(array->HasStandardMemoryLayout())
+  {
+    alias = vtkDataArray::CreateDataArray(array->GetDataType());
+    alias->SetNumberOfComponents(num_comps);
+    alias->SetVoidArray(shareAlias(array, static_cast<T*>(array->GetVoidPointer(0)) + first),
+                        block_size * num_comps, 0, vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+    alias->SetArrayFreeFunction(releaseAlias);
+  }
+  else
+  {
+    alias = array->NewInstance();
+    alias->SetNumberOfComponents(num_comps);
+    alias->InsertTuples(0, block_size, block * block_size, array);
+  }
+  alias->SetName(array->GetName());
+  return alias;
+}
+}
+
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::scanTimeSteps(char* firstTags)
+{
+  char dfName[265];
+  std::string indexName = std::string(this->GetFileName()) + ".idx";
+  std::vector<nek5KIndexEntry> index;
+  char indexTags[32];
+  if(!loadTimeIndex(indexName, this->datafile_format, this->datafile_start, indexTags, index))
+    index.clear();
+
+  int num_parsed = 0;
+  std::vector<nek5KIndexEntry> entries(this->NumberOfTimeSteps);
+  for (int i=0; i<(this->NumberOfTimeSteps); i++)
+  {
+    int file_index = this->datafile_start + i;
+    sprintf(dfName, this->datafile_format.c_str(), 0, file_index );
+    nek5KIndexEntry& entry = entries[i];
+    bool stamped = fileStamp(dfName, entry.mtime, entry.size);
+
+    if(stamped && i < int(index.size()) && index[i].mtime == entry.mtime && index[i].size == entry.size)
+    {
+      entry = index[i];
+      if(0==i)
+        strcpy(firstTags, indexTags);
+    }
+    else
+    {
+      char tmpTags[32];
+      entry.time = 0.0;
+      entry.has_mesh = 0;
+      tmpTags[0] = '\0';
+      readStepHeader(dfName, entry.time, tmpTags);
+      num_parsed++;
+      vtkDebugMacro(<< "vtkNek5000Reader::scanTimeSteps:  i: " << i << " dfName: " << dfName << " time = "<< entry.time);
+
+      // for the first time step on the master
+      if(0==i)
+      {
+        // store the tags for the first step, and share with other procs to parse for variables
+        strcpy(firstTags, tmpTags);
+      }
+      // If this file contains a mesh, the first variable codes after the
+      // cycle number will be X Y
+      entry.has_mesh = (strchr(tmpTags, 'X') != nullptr);
+    }
 
+    this->TimeSteps[i] = entry.time;
+    this->timestep_has_mesh[i] = (entry.has_mesh != 0);
+    vtkDebugMacro(<<"vtkNek5000Reader::scanTimeSteps: this->TimeSteps["<<i<<"]= " <<this->TimeSteps[i]<<"  this->timestep_has_mesh["<<i<<"] = "<< this->timestep_has_mesh[i]);
+  } // for (int i=0; i<(this->NumberOfTimeSteps); i++)
+
+  vtkDebugMacro(<< "vtkNek5000Reader::scanTimeSteps: parsed " << num_parsed << " headers, "
+                << this->NumberOfTimeSteps - num_parsed << " steps from " << indexName);
+  if(num_parsed > 0 || int(index.size()) != this->NumberOfTimeSteps)
+    saveTimeIndex(indexName, this->datafile_format, this->datafile_start, firstTags, entries);
+}// vtkNek5000Reader::scanTimeSteps()
+
+//----------------------------------------------------------------------------
+// The other steps are given the times listed in the .nek5000 file if there
+// are as many as steps, or times spaced evenly between the first and the last.
+// Whether they include the mesh is found out when they are read.
+void vtkNek5000Reader::scanFirstAndLastSteps(char* firstTags)
+{
   char dfName[265];
+  char lastTags[32];
+  double first_time = 0.0, last_time = 0.0;
+  int last = this->NumberOfTimeSteps - 1;
+  if(last < 0)
+    return;
+
+  sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start );
+  readStepHeader(dfName, first_time, firstTags);
+  strcpy(lastTags, firstTags);
+  last_time = first_time;
+  if(last > 0)
+  {
+    sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start + last );
+    readStepHeader(dfName, last_time, lastTags);
+  }
+
+  bool listed = (int(this->listed_times.size()) == this->NumberOfTimeSteps);
+  if(!this->listed_times.empty() && !listed)
+  {
+    std::cerr << "The .nek5000 file lists " << this->listed_times.size() << " times for "
+              << this->NumberOfTimeSteps << " steps, they are ignored" << std::endl;
+  }
+  for (int i=0; i<(this->NumberOfTimeSteps); i++)
+  {
+    if(listed)
+      this->TimeSteps[i] = this->listed_times[i];
+    else
+      this->TimeSteps[i] = first_time + (last > 0 ? i * (last_time - first_time) / last : 0.0);
+    this->timestep_has_mesh[i] = false;
+  }
+  this->TimeSteps[0] = first_time;
+  this->TimeSteps[last] = last_time;
+  this->timestep_has_mesh[0] = (strchr(firstTags, 'X') != nullptr);
+  this->timestep_has_mesh[last] = (strchr(lastTags, 'X') != nullptr);
+
+  vtkDebugMacro(<< "vtkNek5000Reader::scanFirstAndLastSteps: times from " << first_time << " to " << last_time
+                << (listed ? ", listed in " : ", spaced evenly, none listed in ") << this->GetFileName());
+}// vtkNek5000Reader::scanFirstAndLastSteps()
+
+//----------------------------------------------------------------------------
+bool vtkNek5000Reader::stepHasMesh(int step_index)
+{
+  if(!this->timestep_mesh_known[step_index])
+  {
+    char dfName[265];
+    char tags[32];
+    double time;
+    tags[0] = '\0';
+    sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start + step_index );
+    readStepHeader(dfName, time, tags);
+    this->timestep_has_mesh[step_index] = (strchr(tags, 'X') != nullptr);
+    this->timestep_mesh_known[step_index] = true;
+  }
+  return this->timestep_has_mesh[step_index];
+}
+
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::GetAllTimesAndVariableNames(vtkInformationVector *outputVector)
+{
   char firstTags[32];
-  char param[32];
-  int file_index;
-  float test_time_val;
 
   vtkInformation* outInfo = outputVector->GetInformationObject(0);
   //vtkInformation* outInfo1 = outputVector->GetInformationObject(1);
@@ -176,55 +727,35 @@ void vtkNek5000Reader::GetAllTimesAndVariableNames(vtkInformationVector *outputV
 
   this->TimeSteps.resize(this->NumberOfTimeSteps);
   this->timestep_has_mesh =  new bool[this->NumberOfTimeSteps];
+  firstTags[0] = '\0';
 
-  for (int i=0; i<(this->NumberOfTimeSteps); i++)
+  // only the master looks at the files, the other procs get what it found
+  if(0 == my_rank)
   {
-      this->timestep_has_mesh[i] = false;    
-      file_index = this->datafile_start + i;
-
-      sprintf(dfName, this->datafile_format.c_str(), 0, file_index );
-      vtkDebugMacro(<< "vtkNek5000Reader::GetAllTimesAndVariableNames:  this->datafile_start = "<< this->datafile_start<<"  i: " << i << " file_index: "<<file_index<< " dfName: " << dfName );
-
-      dfPtr.open(dfName);
-
-      if ( (dfPtr.rdstate() & std::ifstream::failbit ) != 0 )
-          std::cerr << "Error opening : " << dfName << endl;
-
-      dfPtr >> dummy >> dummy >> dummy >> dummy >> dummy >> dummy >> dummy;
-      dfPtr >> t >> c >> dummy;
-      vtkDebugMacro(<< "vtkNek5000Reader::GetAllTimesAndVariableNames:  time = "<< t <<" cycle =  " << c );
-      //I do this to skip the num directories token, because it may abut
-      //the field tags without a whitespace separator.
-      while (dfPtr.peek() == ' ')
-          dfPtr.get();
-      while (dfPtr.peek() >= '0' && dfPtr.peek() <= '9')
-          dfPtr.get();
-
-      char tmpTags[32];
-      dfPtr.read(tmpTags, 32);
-      tmpTags[31] = '\0';
-
-      v = tmpTags;
-
-      // for the first time step on the master
-      if(0==i)
-      {
-          // store the tags for the first step, and share with other procs to parse for variables
-          strcpy(firstTags, tmpTags);
-      }
-
-      this->TimeSteps[i] = t;
-
-      // If this file contains a mesh, the first variable codes after the
-      // cycle number will be X Y
-      if (v.find("X") != std::string::npos)
-          this->timestep_has_mesh[i] = true;
-
-      dfPtr.close();
-    
-      vtkDebugMacro(<<"vtkNek5000Reader::GetAllTimesAndVariableNames: this->TimeSteps["<<i<<"]= " <<this->TimeSteps[i]<<"  this->timestep_has_mesh["<<i<<"] = "<< this->timestep_has_mesh[i]);
-    
-  } // for (int i=0; i<(this->NumberOfTimeSteps); i++)
+    if(this->FastOpen)
+      this->scanFirstAndLastSteps(firstTags);
+    else
+      this->scanTimeSteps(firstTags);
+  }
+  if(num_ranks > 1)
+  {
+    std::vector<int> has_mesh(this->NumberOfTimeSteps);
+    for (int i=0; i<(this->NumberOfTimeSteps); i++)
+      has_mesh[i] = this->timestep_has_mesh[i];
+    ctrl->Broadcast(this->TimeSteps.data(), this->NumberOfTimeSteps, 0);
+    ctrl->Broadcast(has_mesh.data(), this->NumberOfTimeSteps, 0);
+    ctrl->Broadcast(firstTags, 32, 0);
+    for (int i=0; i<(this->NumberOfTimeSteps); i++)
+      this->timestep_has_mesh[i] = (has_mesh[i] != 0);
+  }
+  // with FastOpen, only the first and last headers were read
+  this->timestep_mesh_known.assign(this->NumberOfTimeSteps, !this->FastOpen);
+  if(this->NumberOfTimeSteps > 0)
+  {
+    this->timestep_mesh_known.front() = true;
+    this->timestep_mesh_known.back() = true;
+  }
+  this->timestep_mesh_step.assign(this->NumberOfTimeSteps, -1);
 
   this->GetVariableNamesFromData(firstTags);
 
@@ -234,6 +765,7 @@ void vtkNek5000Reader::GetAllTimesAndVariableNames(vtkInformationVector *outputV
 
   double timeRange[2];
   timeRange[0] = *this->TimeSteps.begin();
+  timeRange[1] = this->TimeSteps.back();
 
   vtkDebugMacro(<< "vtkNek5000Reader::GetAllTimes: timeRange[0] = "<<timeRange[0]<< ", timeRange[1] = "<< timeRange[1]);
 
@@ -258,6 +790,38 @@ unsigned long vtkNek5000Reader::GetMTime()
 void vtkNek5000Reader::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseMemoryMap: " << this->UseMemoryMap << endl;
+  os << indent << "BlockedVectors: " << this->BlockedVectors << endl;
+  os << indent << "DoublePrecision: " << this->DoublePrecision << endl;
+  os << indent << "NumberOfReadRequests: " << this->NumberOfReadRequests << endl;
+  os << indent << "NumberOfBytesRead: " << this->NumberOfBytesRead << endl;
+  os << indent << "NumberOfPerElementReadRequests: " << this->NumberOfPerElementReadRequests << endl;
+  os << indent << "UseMPIIO: " << this->UseMPIIO << endl;
+  os << indent << "FastOpen: " << this->FastOpen << endl;
+  os << indent << "PrefetchDepth: " << this->PrefetchDepth << endl;
+  os << indent << "PrefetchDirection: " << this->PrefetchDirection << endl;
+  os << indent << "CacheSize: " << this->CacheSize << endl;
+  os << indent << "GeometryCache: " << this->GeometryCache << endl;
+  os << indent << "LowMemory: " << this->LowMemory << endl;
+  os << indent << "HighOrderCells: " << this->HighOrderCells << endl;
+  os << indent << "StructuredOutput: " << this->StructuredOutput << endl;
+  os << indent << "ElementStride: " << this->ElementStride << endl;
+  os << indent << "ProjectionOrder: " << this->ProjectionOrder << endl;
+  os << indent << "RegionOfInterest: " << this->RegionOfInterest << endl;
+  os << indent << "RegionBounds: " << this->RegionBounds[0] << ", " << this->RegionBounds[1] << ", "
+     << this->RegionBounds[2] << ", " << this->RegionBounds[3] << ", "
+     << this->RegionBounds[4] << ", " << this->RegionBounds[5] << endl;
+  os << indent << "RegionOrigin: " << this->RegionOrigin[0] << ", " << this->RegionOrigin[1] << ", "
+     << this->RegionOrigin[2] << endl;
+  os << indent << "RegionNormal: " << this->RegionNormal[0] << ", " << this->RegionNormal[1] << ", "
+     << this->RegionNormal[2] << endl;
+  os << indent << "RegionThickness: " << this->RegionThickness << endl;
+  os << indent << "ValueOfInterest: " << this->ValueOfInterest << endl;
+  os << indent << "ValueArrayName: " << (this->ValueArrayName ? this->ValueArrayName : "(none)") << endl;
+  os << indent << "ValueRange: " << this->ValueRange[0] << ", " << this->ValueRange[1] << endl;
+  os << indent << "PeakMemoryBytes: " << this->PeakMemoryBytes << endl;
+  os << indent << "NumberOfPrefetchHits: " << this->NumberOfPrefetchHits << endl;
+  os << indent << "NumberOfPrefetchMisses: " << this->NumberOfPrefetchMisses << endl;
 }
 
 //----------------------------------------------------------------------------
@@ -523,16 +1087,124 @@ vtkDebugMacro(<< "GetVariableNamesFromData:  this->var_names[" << this->num_vars
 }
 
 //----------------------------------------------------------------------------
+// Vectors are stored per element as all X values, then all Y, then all Z.
+// Turn them into tuples in place. The elements are independent, and are
+// shared among the threads.
+template <class T>
+static void interleaveBlocks(T* values, long num_blocks, long block_size, int num_comps)
+{
+  vtkSMPTools::For(0, num_blocks, [&](vtkIdType begin, vtkIdType end) {
+    std::vector<T> block(block_size * num_comps);
+    for(vtkIdType b = begin; b < end; b++)
+    {
+      T* element = values + b * block_size * num_comps;
+      memcpy(block.data(), element, block.size() * sizeof(T));
+      for(long p = 0; p < block_size; p++)
+      {
+        for(int c = 0; c < num_comps; c++)
+        {
+          element[p * num_comps + c] = block[c * block_size + p];
+        }
+      }
+    }
+  });
+}
+
+//----------------------------------------------------------------------------
+// a new vtkFloatArray or vtkDoubleArray
+template <class T>
+static vtkAOSDataArrayTemplate<T>* newPlainArray(int num_comps, vtkIdType num_tuples)
+{
+  vtkAOSDataArrayTemplate<T>* array = static_cast<vtkAOSDataArrayTemplate<T>*>(
+    vtkDataArray::CreateDataArray(vtkTypeTraits<T>::VTK_TYPE_ID));
+  array->SetNumberOfComponents(num_comps);
+  array->SetNumberOfTuples(num_tuples);
+  return array;
+}
 
-void vtkNek5000Reader::readData(char* dfName)
+//----------------------------------------------------------------------------
+// FNV-1a hash of the values of an array, to tell the coordinates of steps apart
+static size_t hashPoints(vtkDataArray* coords)
 {
-  long total_header_size = 136 + (this->numBlocks * 4);
-  long read_location;
-  long read_size;
-  std::ifstream dfPtr;
-  float* dataPtr;
-  double *tmpDblPtr;
+  return size_t(hashBytes(coords->GetVoidPointer(0), size_t(coords->GetNumberOfValues()) * coords->GetDataTypeSize()));
+}
+
+// see if two arrays hold the same values
+static bool samePoints(vtkDataArray* a, vtkDataArray* b)
+{
+  return a->GetDataType() == b->GetDataType() && a->GetNumberOfValues() == b->GetNumberOfValues() &&
+    memcmp(a->GetVoidPointer(0), b->GetVoidPointer(0), size_t(a->GetNumberOfValues()) * a->GetDataTypeSize()) == 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkNek5000Reader::outputDataType()
+{
+  return (this->DoublePrecision && this->precision == 8) ? VTK_DOUBLE : VTK_FLOAT;
+}
+
+//----------------------------------------------------------------------------
+// Lagrange cells of different orders per direction would need a degrees
+// array, Nek5000 elements have the same order in each direction.
+bool vtkNek5000Reader::useHighOrderCells()
+{
+  return this->HighOrderCells &&
+    this->blockDims[1] == this->blockDims[0] && (!this->MeshIs3D || this->blockDims[2] == this->blockDims[0]);
+}
+
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::releaseDataArrays()
+{
+  for(auto& array : this->dataArray)
+  {
+    if(array)
+      array->Delete();
+    array = nullptr;
+  }
+  this->dataRanges.clear();
+}
+
+//----------------------------------------------------------------------------
+// The value ranges of 'array', of 'block_size' tuples per element for each of
+// the 'num_blocks' elements: the minimum and maximum of each component over
+// each element, in 'ranges'. The values of an element are next to each other,
+// one tuple after the other or, in a blocked array, one component after the
+// other.
+template <class T>
+static void computeElementRanges(vtkDataArray* array, int num_blocks, long block_size, std::vector<float>& ranges)
+{
+  const int num_comps = array->GetNumberOfComponents();
+  vtkNek5000BlockedArray<T>* blocked = vtkNek5000BlockedArray<T>::SafeDownCast(array);
+  const T* values = blocked ? blocked->GetBlockedData() : static_cast<T*>(array->GetVoidPointer(0));
+  // the distance of consecutive values of a component, and of the first values of two components
+  const long step = blocked ? 1 : num_comps;
+  const long comp_offset = blocked ? block_size : 1;
+  ranges.resize(2 * size_t(num_blocks) * num_comps);
+  vtkSMPTools::For(0, num_blocks, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType e = begin; e < end; ++e)
+    {
+      for(int c = 0; c < num_comps; ++c)
+      {
+        const T* v = values + e * block_size * num_comps + c * comp_offset;
+        T lo = v[0], hi = v[0];
+        for(long k = 1; k < block_size; ++k)
+        {
+          T value = v[k * step];
+          if(value < lo)
+            lo = value;
+          if(value > hi)
+            hi = value;
+        }
+        ranges[2 * (e * num_comps + c)] = floatBelow(lo);
+        ranges[2 * (e * num_comps + c) + 1] = floatAbove(hi);
+      }
+    }
+  });
+}
+
+//----------------------------------------------------------------------------
 
+bool vtkNek5000Reader::readData(char* dfName)
+{
   int my_rank;
   vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
   if (ctrl != nullptr)
@@ -544,194 +1216,324 @@ void vtkNek5000Reader::readData(char* dfName)
     my_rank = 0;
   }
 
-  dfPtr.open(dfName, std::ifstream::binary);
-  if(dfPtr.is_open())
+  // the arrays read before are now owned by the cache
+  this->releaseDataArrays();
+
+  // read the variables selected which the cache does not hold for this step
+  std::vector<int> missing(this->num_vars);
+  for(int i=0; i<this->num_vars; i++)
+  {
+    missing[i] = this->use_variable[i] && !this->curObj->arrays[i];
+  }
+  bool collective = this->useCollectiveIO();
+  if(collective)
+  {
+    // the ranks read the same variables; those already cached are dropped afterwards
+    MPI_Allreduce(MPI_IN_PLACE, missing.data(), this->num_vars, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  }
+  std::vector<bool> vars(missing.begin(), missing.end());
+  nek5KReadStats stats;
+  nek5KReadSettings settings = this->readSettings();
+  // found by all ranks together in RequestData(), see meshStepOf()
+  settings.hasMesh = this->timestep_has_mesh[this->ActualTimeStep];
+  if(!this->readStep(dfName, settings, vars, this->dataArray, this->dataRanges, stats, collective))
+  {
+    vtkErrorMacro(<< "Error reading datafile : " << dfName);
+    return false;
+  }
+  this->addReadStats(stats);
+
+#ifdef COMPUTE_MIN_MAX
+  for(auto i=0; i<this->num_vars; i++)
   {
-    // if this data file includes the mesh, add it to header size
-    if(this->timestep_has_mesh[this->ActualTimeStep])
+    vtkDataArray* array = this->dataArray[i];
+    if(array)
     {
-      long offset1;
-      offset1 = this->numBlocks;
-      offset1 *= this->totalBlockSize;
-      if (this->MeshIs3D)
-        offset1 *= 3; // account for X, Y and Z
-      else
-        offset1 *= 2;  // account only for X, Y
-      offset1 *= this->precision;
-      total_header_size += offset1;
+      // Check the data ranges, those of the elements gathered
+      const std::vector<float>& ranges = this->dataRanges[i];
+      int num_comps = array->GetNumberOfComponents();
+      for(auto k=0; k<num_comps; k++)
+      {
+        double range[2] = { VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+        for(auto e=0; e<this->myNumBlocks; e++)
+        {
+          range[0] = std::min(range[0], double(ranges[2 * (e * num_comps + k)]));
+          range[1] = std::max(range[1], double(ranges[2 * (e * num_comps + k) + 1]));
+        }
+        vtkDebugMacro(<<"Rank: "<< my_rank<< "  dataArray["<<this->var_names[i]<<"]["<<k<<"] : ["<<range[0]<<", "<<range[1]<<"]");
+      }
     }
-    // currently reading a block at a time, if we need doubles, allocate an array for a block
-    if(this->precision == 8)
+  }  // for all vars
+#endif
+
+  return true;
+}// vtkNek5000Reader::readData(char* dfName)
+
+//----------------------------------------------------------------------------
+// Hand the arrays just read over to the cache object of the step.
+void vtkNek5000Reader::cacheDataArrays()
+{
+  for(int i=0; i<int(this->dataArray.size()); i++)
+  {
+    if(this->dataArray[i] && !this->curObj->arrays[i])
     {
-      tmpDblPtr = new double[this->totalBlockSize * 3];
+      this->curObj->arrays[i] = this->dataArray[i];
+      this->dataArray[i] = nullptr;
+      if(i < int(this->dataRanges.size()))
+        this->curObj->ranges[i].swap(this->dataRanges[i]);
     }
+  }
+  this->releaseDataArrays();
+}// vtkNek5000Reader::cacheDataArrays()
 
-    // for each variable
-    long var_offset;
-    long l_blocksize, scalar_offset;
-    scalar_offset  = this->numBlocks;
-    scalar_offset *= this->totalBlockSize;
-    scalar_offset *= this->precision;
-    
-    for(auto i=0; i < this->num_vars; i++)
-    {
-      if(i < 2){ // if Velocity or Velocity Magnitude
-        var_offset = 0;
-        }
-      else{
-        if (this->MeshIs3D)
-          var_offset = (3 + (i-2))*scalar_offset; // counts VxVyVz
-        else
-          var_offset = (2 + (i-2))*scalar_offset; // counts VxVy
-          }
-      dataPtr = this->dataArray[i];
+//----------------------------------------------------------------------------
+// Read the variables 'vars' of the time step stored in 'dfName', with the
+// options and blocks of 'settings', into new arrays in 'arrays', and find
+// their value ranges per element, in 'ranges'. Everything else in the reader
+// is left alone, and only its layout of the files is used,
+// as this runs in the prefetch thread too. If 'collective', all ranks must
+// call it together. Returns false if the file cannot be opened.
+bool vtkNek5000Reader::readStep(const char* dfName, const nek5KReadSettings& settings, const std::vector<bool>& vars,
+                                std::vector<vtkDataArray*>& arrays, std::vector<std::vector<float>>& ranges,
+                                nek5KReadStats& stats, bool collective)
+{
+  long total_header_size = 136 + (this->numBlocks * 4);
+  long read_size;
+  nek5KDataFile dataFile;
 
-      if(dataPtr)
-      {
-        if(strcmp(this->var_names[i], "Velocity") == 0 && !this->MeshIs3D)
-          {
-          read_size =   this->totalBlockSize * 2;
-          }
-        else
-          {
-          read_size =   this->totalBlockSize * this->var_length[i];
-          }
-        l_blocksize = read_size * this->precision;
+  arrays.assign(this->num_vars, nullptr);
+  ranges.assign(this->num_vars, std::vector<float>());
+  if(!dataFile.open(dfName, settings.useMemoryMap != 0, collective))
+  {
+    return false;
+  }
 
-        if(this->precision == 4)
-        {
-          for(auto j=0; j < this->myNumBlocks; j++)
-          {
-            read_location = total_header_size + var_offset + long(this->myBlockPositions[j] * l_blocksize );
-            dfPtr.seekg(read_location, std::ios_base::beg );
-            if (!dfPtr)
-              std::cerr << __LINE__ << "block="<< j << ": seekg error for block position = " << this->myBlockPositions[j] << std::endl;
-            dfPtr.read( (char *)dataPtr, read_size*sizeof(float));
-            if (!dfPtr)
-              std::cerr << __LINE__ << ": read error for paylood of " << read_size << " floats = " << read_size*sizeof(float) << std::endl;
+  // if this data file includes the mesh, add it to header size
+  if(settings.hasMesh)
+  {
+    long offset1;
+    offset1 = this->numBlocks;
+    offset1 *= this->fileBlockSize;
+    if (this->MeshIs3D)
+      offset1 *= 3; // account for X, Y and Z
+    else
+      offset1 *= 2;  // account only for X, Y
+    offset1 *= this->precision;
+    total_header_size += offset1;
+  }
+  // for each variable
+  long var_offset;
+  long l_blocksize, scalar_offset;
+  scalar_offset  = this->numBlocks;
+  scalar_offset *= this->fileBlockSize;
+  scalar_offset *= this->precision;
+
+  for(auto i=0; i < this->num_vars; i++)
+  {
+    if(i < 2){ // if Velocity or Velocity Magnitude
+      var_offset = 0;
+      }
+    else{
+      if (this->MeshIs3D)
+        var_offset = (3 + (i-2))*scalar_offset; // counts VxVyVz
+      else
+        var_offset = (2 + (i-2))*scalar_offset; // counts VxVy
+        }
+    bool isVelocity = (strcmp(this->var_names[i], "Velocity") == 0);
+    // the velocity magnitude is derived from the velocity, which is read even if only the magnitude is requested
+    bool needMagnitude = isVelocity && i+1 < this->num_vars && vars[i+1];
+
+    if(vars[i] || needMagnitude)
+    {
 /*
 when reading vectors, such as Velocity, first come all Vx components, then all Vy, then all Vz.
-if reading 2D, it is safer to set the Z component to 0.
+if reading 2D, only Vx and Vy are stored, and readBlocks sets the Z component to 0.
 */
-            if(strcmp(this->var_names[i], "Velocity") == 0 && !this->MeshIs3D)
-              {
-              //memset(&dataPtr[read_size], 0, read_size*sizeof(float));    
-              }
-            dataPtr += this->totalBlockSize * this->var_length[i];
-          }
-          if(this->swapEndian)
-          {
-            std::cout << "ByteSwap32()\n";
-            ByteSwap32(this->dataArray[i], this->myNumBlocks*this->totalBlockSize* this->var_length[i]);
-          }
+      if(isVelocity && !this->MeshIs3D)
+        {
+        read_size =   this->fileBlockSize * 2;
         }
-        else // precision == 8
+      else
         {
-          for(auto j=0; j<this->myNumBlocks; j++)
-          {
-            read_location = total_header_size + var_offset + long(this->myBlockPositions[j] * l_blocksize );
-            dfPtr.seekg(read_location, std::ios_base::beg );
-            if (!dfPtr)
-              std::cerr << __LINE__ << ": seekg error at read_location = " << read_location << std::endl;
-            dfPtr.read( (char *)tmpDblPtr, read_size*sizeof(double));
-            if (!dfPtr)
-              std::cerr << __LINE__ << ": read error\n";
-            for(auto ind=0; ind<read_size; ind++)
-            {
-              *dataPtr = (float)tmpDblPtr[ind];
-              dataPtr++;
-            }
-          }
-          if(this->swapEndian)
-            ByteSwap64(this->dataArray[i], this->myNumBlocks*this->totalBlockSize* this->var_length[i]);
+        read_size =   this->fileBlockSize * this->var_length[i];
         }
+      l_blocksize = read_size * this->precision;
 
-        // if this is velocity, also add the velocity magnitude if and only if it has also been requested
-        if(strcmp(this->var_names[i], "Velocity") == 0 and this->GetPointArrayStatus("Velocity Magnitude"))
+      vtkDataArray* array;
+      if(settings.dataType == VTK_DOUBLE)
+        array = this->readVariable<double>(dataFile, settings, i, total_header_size + var_offset, l_blocksize,
+                                           needMagnitude, arrays, stats);
+      else
+        array = this->readVariable<float>(dataFile, settings, i, total_header_size + var_offset, l_blocksize,
+                                          needMagnitude, arrays, stats);
+      if(!array)
+      {
+        for(vtkDataArray*& read : arrays)
         {
-          float vx, vy, vz;
-          int coord_offset = this->totalBlockSize;  // number of values for one coordinate (X or Y or Z)
-          for(auto j=0; j<this->myNumBlocks; j++)
-          {
-            int mag_block_offset = j*this->totalBlockSize;
-            int comp_block_offset = mag_block_offset * 3;
-            for(auto k=0; k<this->totalBlockSize; k++)
-            {
-              vx = this->dataArray[i][                              comp_block_offset + k];
-              vy = this->dataArray[i][               coord_offset + comp_block_offset + k];
-              vz = this->dataArray[i][coord_offset + coord_offset + comp_block_offset + k];
-              this->dataArray[i+1][mag_block_offset+k] = std::sqrt((vx*vx) + (vy*vy) + (vz*vz));
-            }
-          }
-          i++;  // skip over the velocity magnitude variable, since we just took care of it
-        } // if "Velocity"
-      } // only read if valid pointer
-    }  // for(i=0; i<this->num_vars; i++)
+          if(read)
+            read->Delete();
+          read = nullptr;
+        }
+        dataFile.close();
+        return false;
+      }
+      array->SetName(this->var_names[i]);
+      arrays[i] = array;
+
+      if(!vars[i])
+      {
+        array->Delete();
+        arrays[i] = nullptr;
+      }
+    } // only read if used
+    if(isVelocity)
+    {
+      i++;  // skip over the velocity magnitude variable, since we just took care of it
+    }
+  }  // for(i=0; i<this->num_vars; i++)
+
+  dataFile.close();
+
+  for(auto i=0; i < this->num_vars; i++)
+  {
+    if(!arrays[i])
+      continue;
+    if(arrays[i]->GetDataType() == VTK_DOUBLE)
+      computeElementRanges<double>(arrays[i], this->myNumBlocks, settings.totalBlockSize, ranges[i]);
+    else
+      computeElementRanges<float>(arrays[i], this->myNumBlocks, settings.totalBlockSize, ranges[i]);
+  }
+  return true;
+}// vtkNek5000Reader::readStep()
+
+//----------------------------------------------------------------------------
+nek5KReadSettings vtkNek5000Reader::readSettings()
+{
+  nek5KReadSettings settings;
+  settings.dataType = this->dataType;
+  settings.blockedVectors = this->BlockedVectors;
+  settings.useMemoryMap = this->UseMemoryMap;
+  settings.hasMesh = false;
+  settings.readPlan = this->readPlan;
+  for(int d=0; d<3; d++)
+  {
+    settings.blockDims[d] = this->blockDims[d];
+    settings.projection[d] = this->projection[d];
+  }
+  settings.totalBlockSize = this->totalBlockSize;
+  settings.sampledPoints = this->sampledPoints;
+  settings.sampledRuns = this->sampledRuns;
+  return settings;
+}// vtkNek5000Reader::readSettings()
+
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::addReadStats(const nek5KReadStats& stats)
+{
+  this->NumberOfReadRequests += stats.requests;
+  this->NumberOfBytesRead += stats.bytes;
+  this->NumberOfPerElementReadRequests += stats.per_element_requests;
+}
 
-    if(this->precision == 8)
+//----------------------------------------------------------------------------
+// Read variable i, whose blocks are 'block_size' bytes long in the file and
+// start at 'offset', into a new array of type T. If 'needMagnitude', the
+// velocity magnitude is also derived, into arrays[i+1].
+template <class T>
+vtkDataArray* vtkNek5000Reader::readVariable(nek5KDataFile& dataFile, const nek5KReadSettings& settings, int i,
+                                             long offset, long block_size, bool needMagnitude,
+                                             std::vector<vtkDataArray*>& arrays, nek5KReadStats& stats)
+{
+  vtkDataArray* array;
+  T* values;
+  long num_tuples = long(this->myNumBlocks) * settings.totalBlockSize;
+  bool mapped = this->canMapVariable(dataFile, settings, i, offset, block_size);
+  long mapped_offset = mapped ? offset + settings.readPlan.runs[0].position * block_size : 0;
+  if(this->var_length[i] > 1 && settings.blockedVectors)
+  {
+    // keep the per-element layout of the file, the array presents it as tuples
+    vtkNek5000BlockedArray<T>* blocked = vtkNek5000BlockedArray<T>::New();
+    blocked->SetBlockSize(settings.totalBlockSize);
+    blocked->SetNumberOfComponents(this->var_length[i]);
+    if(mapped)
     {
-      delete [] tmpDblPtr;
+      blocked->SetArray((T*)nek5KMapping::share(dataFile.mapping, mapped_offset), num_tuples, nek5KMapping::release);
     }
-    dfPtr.close();
+    else
+    {
+      blocked->SetNumberOfTuples(num_tuples);
+    }
+    values = blocked->GetBlockedData();
+    array = blocked;
+  }
+  else if(mapped)
+  {
+    array = nek5KMapping::wrap(dataFile.mapping, settings.dataType, mapped_offset, num_tuples);
+    values = static_cast<T*>(array->GetVoidPointer(0));
   }
   else
   {
-    std::cerr << "Error opening datafile : " << dfName << endl;
-    exit(1);
+    vtkAOSDataArrayTemplate<T>* plain = newPlainArray<T>(this->var_length[i], num_tuples);
+    values = plain->GetPointer(0);
+    array = plain;
   }
 
-#ifdef COMPUTE_MIN_MAX
-  for(auto i=0; i<this->num_vars; i++)
+  if(mapped)
   {
-    float dmin[3]={VTK_FLOAT_MAX, VTK_FLOAT_MAX, VTK_FLOAT_MAX};
-    float dmax[3]={VTK_FLOAT_MIN, VTK_FLOAT_MIN, VTK_FLOAT_MIN};
-    
-    dataPtr = this->dataArray[i];
-    if(dataPtr)
+    // the values are used in place, in the mapped file
+    stats.requests++;
+    stats.bytes += this->myNumBlocks * block_size;
+    stats.per_element_requests += this->myNumBlocks;
+  }
+  else
+  {
+    // read straight into the storage of the point-data array
+    if(!this->readBlocks(dataFile, settings, offset, block_size, values, settings.totalBlockSize * this->var_length[i],
+                         stats))
     {
-      // Check the data ranges
-      for(auto j=0; j<this->myNumBlocks; j++)
-      {
-        for(int a=0; a<this->totalBlockSize; a++)
-        {
-          if(i==0)
-          {
-            for(auto k=0; k<3; k++)
-            {
-               if(this->dataArray[i][j*this->totalBlockSize*3 + a +(this->totalBlockSize*k)] > dmax[k])
-                 dmax[k] = this->dataArray[i][j*this->totalBlockSize*3 + a +(this->totalBlockSize*k)];
-               if(this->dataArray[i][j*this->totalBlockSize*3 + a +(this->totalBlockSize*k)] < dmin[k])
-                 dmin[k] = this->dataArray[i][j*this->totalBlockSize*3 + a +(this->totalBlockSize*k)];
-            }
-          }
-          else
-          {
-            if(this->dataArray[i][j*this->totalBlockSize + a] > dmax[0])
-              dmax[0] = this->dataArray[i][j*this->totalBlockSize + a];
-            if(this->dataArray[i][j*this->totalBlockSize + a] < dmin[0])
-              dmin[0] = this->dataArray[i][j*this->totalBlockSize + a];
-          }
-        }
-      }
+      array->Delete();
+      return nullptr;
+    }
+  }
 
-      vtkDebugMacro(<<"Rank: "<< my_rank<< "  dataArray["<<this->var_names[i]<<"] : ["<<dmin[0]<<", "<<dmax[0]<<"]");
-      if(!strcmp(this->var_names[i], "Velocity"))
+  // if this is velocity, also add the velocity magnitude if and only if it has also been requested
+  if(needMagnitude)
+  {
+    vtkAOSDataArrayTemplate<T>* magnitude = newPlainArray<T>(1, num_tuples);
+    magnitude->SetName(this->var_names[i+1]);
+    const T* vel = values;
+    T* mag = magnitude->GetPointer(0);
+    T vx, vy, vz;
+    int coord_offset = settings.totalBlockSize;  // number of values for one coordinate (X or Y or Z)
+    for(auto j=0; j<this->myNumBlocks; j++)
+    {
+      long mag_block_offset = long(j)*settings.totalBlockSize;
+      long comp_block_offset = mag_block_offset * 3;
+      for(auto k=0; k<settings.totalBlockSize; k++)
       {
-        vtkDebugMacro(<<"Rank: "<< my_rank<< "  dataArray["<<this->var_names[i]<<"][1] : ["<<dmin[1]<<", "<<dmax[1]<<"]");
-        vtkDebugMacro(<<"Rank: "<< my_rank<< "  dataArray["<<this->var_names[i]<<"][2] : ["<<dmin[2]<<", "<<dmax[2]<<"]");
+        vx = vel[                              comp_block_offset + k];
+        vy = vel[               coord_offset + comp_block_offset + k];
+        vz = vel[coord_offset + coord_offset + comp_block_offset + k];
+        mag[mag_block_offset+k] = std::sqrt((vx*vx) + (vy*vy) + (vz*vz));
       }
     }
-  }  // for all vars
-#endif
+    arrays[i+1] = magnitude;
+  } // if "Velocity"
 
-}// vtkNek5000Reader::readData(char* dfName)
+  if(this->var_length[i] > 1 && !settings.blockedVectors)
+  {
+    // vectors are stored per element as all X, then all Y, then all Z; make tuples of them
+    interleaveBlocks(values, this->myNumBlocks, settings.totalBlockSize, this->var_length[i]);
+  }
+  return array;
+}// vtkNek5000Reader::readVariable()
 
 //----------------------------------------------------------------------------
     
 void vtkNek5000Reader::partitionAndReadMesh()
 {
   char dfName[265];
-  std::ifstream dfPtr;
+  nek5KDataFile dataFile;
+  std::ifstream& dfPtr = dataFile.stream;
   int i;
   string buf2, tag;
   std::map<int,int> blockMap;
@@ -750,10 +1552,12 @@ void vtkNek5000Reader::partitionAndReadMesh()
     num_ranks = 1;
   }
 
+  // the prefetch thread reads with the partition and layout made here
+  this->discardPrefetchedSteps();
+
   sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start );
-  dfPtr.open(dfName);
     
-  if ( (dfPtr.rdstate() & std::ifstream::failbit ) != 0 )
+  if (!dataFile.open(dfName, this->UseMemoryMap != 0))
   {
     std::cerr << "Error opening : " << dfName << endl;
     exit(1);
@@ -766,14 +1570,14 @@ void vtkNek5000Reader::partitionAndReadMesh()
     exit(1);
   }
   dfPtr >> this->precision;
-  dfPtr >> this->blockDims[0];
-  dfPtr >> this->blockDims[1];
-  dfPtr >> this->blockDims[2];
+  dfPtr >> this->fileBlockDims[0];
+  dfPtr >> this->fileBlockDims[1];
+  dfPtr >> this->fileBlockDims[2];
   dfPtr >> buf2;  //blocks per file
   dfPtr >> this->numBlocks;
 
-  this->totalBlockSize =  this->blockDims[0] *  this->blockDims[1] *  this->blockDims[2];
-  if(this->blockDims[2] > 1){
+  this->fileBlockSize =  this->fileBlockDims[0] *  this->fileBlockDims[1] *  this->fileBlockDims[2];
+  if(this->fileBlockDims[2] > 1){
     this->MeshIs3D = true;
     std::cout << "3D-Mesh found";
     }
@@ -781,7 +1585,8 @@ void vtkNek5000Reader::partitionAndReadMesh()
     this->MeshIs3D = false;
     std::cout << "2D-Mesh found";
     }
-  std::cout << ", spectral element of size = " << this->blockDims[0] <<"*"<<  this->blockDims[1] <<"*"<<  this->blockDims[2] <<"="<< this->totalBlockSize << std::endl;
+  std::cout << ", spectral element of size = " << this->fileBlockDims[0] <<"*"<<  this->fileBlockDims[1] <<"*"<<  this->fileBlockDims[2] <<"="<< this->fileBlockSize << std::endl;
+  this->updateElementSampling();
 
   float test;
   dfPtr.seekg( 132, std::ios_base::beg );
@@ -801,21 +1606,17 @@ void vtkNek5000Reader::partitionAndReadMesh()
       exit(1);
     }
   }
+  vtkDebugMacro(<< "partitionAndReadMesh: swapEndian = " << this->swapEndian << ", using the "
+                << nek5KSwapKernelName() << " swap and conversion kernels");
 
   int *tmpBlocks = new int[numBlocks];
+  // the region of interest was changed since the last partition
+  if(this->proc_numBlocks)
+    delete [] this->proc_numBlocks;
+  if(this->myBlockPositions)
+    delete [] this->myBlockPositions;
   this->proc_numBlocks = new int[num_ranks];
 
-  // figure out how many blocks (elements) each proc will handle
-  int elements_per_proc = this->numBlocks / num_ranks;
-  int one_extra_until = this->numBlocks % num_ranks;
-
-  for(i=0; i<num_ranks; i++)
-  {
-    this->proc_numBlocks[i] = elements_per_proc + (i<one_extra_until ? 1 : 0 );
-  }
-  this->myNumBlocks = this->proc_numBlocks[my_rank];
-  this->myBlockIDs = new int[this->myNumBlocks];
-
   // read the ids of all of the blocks in the file
   dfPtr.seekg( 136, std::ios_base::beg );
   dfPtr.read( (char *)tmpBlocks, this->numBlocks*sizeof(int) );
@@ -829,12 +1630,9 @@ void vtkNek5000Reader::partitionAndReadMesh()
   }
 
   // if there is a .map file, we will use that to partition the blocks
-  char* map_filename = strdup(this->GetFileName());
-  char* ext = strrchr(map_filename, '.');
+  std::string map_filename = partitionMapName(this->GetFileName());
   int* all_element_list;
-  ext++;
-  sprintf(ext, "map");
-  std::ifstream  mptr(map_filename);
+  std::ifstream  mptr(map_filename.c_str());
   int *map_elements = nullptr;
   if(mptr.is_open())
   {
@@ -857,7 +1655,43 @@ void vtkNek5000Reader::partitionAndReadMesh()
     vtkDebugMacro(<< "vtkNek5000Reader::partitionAndReadMesh: did not find mapfile: "<<map_filename);
     all_element_list = tmpBlocks;
   }
-  free(map_filename);
+
+  // the elements to partition: all of them, or those intersecting the region of interest,
+  // by their index in all_element_list
+  std::vector<int> selected;
+  this->region_applied = this->regionSettings();
+  if(!this->region_applied.empty())
+  {
+    this->updateElementBounds(dataFile, std::vector<int>(all_element_list, all_element_list + this->numBlocks),
+                              blockMap);
+    for(i=0; i<this->numBlocks; i++)
+    {
+      if(this->elementInRegion(&this->elementBounds[6 * size_t(blockMap.find(all_element_list[i])->second)]))
+        selected.push_back(i);
+    }
+    vtkDebugMacro(<< "partitionAndReadMesh: " << selected.size() << " of " << this->numBlocks
+                  << " elements intersect the region of interest");
+    if(selected.empty())
+      std::cerr << "vtkNek5000Reader: no element intersects the region of interest" << endl;
+  }
+  else
+  {
+    selected.resize(this->numBlocks);
+    for(i=0; i<this->numBlocks; i++)
+      selected[i] = i;
+  }
+  int num_selected = int(selected.size());
+
+  // figure out how many blocks (elements) each proc will handle
+  int elements_per_proc = num_selected / num_ranks;
+  int one_extra_until = num_selected % num_ranks;
+
+  for(i=0; i<num_ranks; i++)
+  {
+    this->proc_numBlocks[i] = elements_per_proc + (i<one_extra_until ? 1 : 0 );
+  }
+  this->myNumBlocks = this->proc_numBlocks[my_rank];
+  this->myBlockIDs = new int[this->myNumBlocks];
 
   int start_index=0;
   for(i=0; i<my_rank; i++)
@@ -865,14 +1699,24 @@ void vtkNek5000Reader::partitionAndReadMesh()
     start_index += this->proc_numBlocks[i];
   }
   // copy my list of elements
+  this->myElementIndices.resize(this->myNumBlocks);
   for(i=0; i<this->myNumBlocks; i++)
   {
-    this->myBlockIDs[i] = all_element_list[start_index+i];
+    this->myElementIndices[i] = selected[start_index+i];
+    this->myBlockIDs[i] = all_element_list[this->myElementIndices[i]];
   }
-  // if they came from the map file, sort them
+  // if they came from the map file, sort them, with the element indices that give their ids
   if(map_elements != nullptr)
     {
-    qsort(this->myBlockIDs, this->myNumBlocks, sizeof(int), compare_ids);
+    std::vector<std::pair<int,int>> sorted(this->myNumBlocks);
+    for(i=0; i<this->myNumBlocks; i++)
+      sorted[i] = std::make_pair(this->myBlockIDs[i], this->myElementIndices[i]);
+    std::sort(sorted.begin(), sorted.end());
+    for(i=0; i<this->myNumBlocks; i++)
+      {
+      this->myBlockIDs[i] = sorted[i].first;
+      this->myElementIndices[i] = sorted[i].second;
+      }
     }
 
   // now that we have our list of blocks, get their positions in the file (their index)
@@ -883,6 +1727,11 @@ void vtkNek5000Reader::partitionAndReadMesh()
     this->myBlockPositions[i] = blockMap.find(this->myBlockIDs[i])->second;
   }
 
+  // group the blocks which are adjacent in the file into runs read at once
+  this->readPlan.build(this->myBlockPositions, this->myNumBlocks);
+  vtkDebugMacro(<< "partitionAndReadMesh: my_rank= " << my_rank << ": " << this->myNumBlocks
+                << " blocks in " << this->readPlan.runs.size() << " contiguous runs");
+
   // TEMP: checking for duplicates within myBlockPositions
   if(map_elements != nullptr)
   {
@@ -902,128 +1751,881 @@ void vtkNek5000Reader::partitionAndReadMesh()
   if(map_elements != nullptr)
     delete [] map_elements;
 
-  // now read the coordinates for all of my blocks
-  if(nullptr == this->meshCoords)
+  delete [] this->myBlockIDs;
+  dataFile.close();
+
+  // the coordinates are read per step, see updateStepPoints()
+  this->dataType = this->outputDataType();
+}// void vtkNek5000Reader::partitionAndReadMesh()
+
+//----------------------------------------------------------------------------
+// The bounds of all elements, made once. Unless every rank finds them in the
+// bounds file, each rank computes those of the elements it reads without a
+// region of interest, from the coordinates in 'dataFile', the file of the
+// first step, and all ranks gather them. Only rank 0 writes the file.
+void vtkNek5000Reader::updateElementBounds(nek5KDataFile& dataFile, const std::vector<int>& elements,
+                                           const std::map<int,int>& blockMap)
+{
+  if(this->elementBounds.size() == 6 * size_t(this->numBlocks))
+    return;
+
+  int my_rank = 0, num_ranks = 1;
+  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
+  if (ctrl != nullptr)
   {
-    vtkDebugMacro(<< ": partitionAndReadMesh:  ALLOCATE meshCoords[" << this->myNumBlocks <<"*"<< this->totalBlockSize <<"*" <<3 << "]");
-    this->meshCoords = new float[this->myNumBlocks * this->totalBlockSize * 3];
+    my_rank = ctrl->GetLocalProcessId();
+    num_ranks = ctrl->GetNumberOfProcesses();
   }
 
-  long total_header_size = 136 + (this->numBlocks * 4);
-  long read_location, offset1;
+  char dfName[265];
+  sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start);
+  int64_t mesh_mtime = 0, mesh_size = 0;
+  fileStamp(dfName, mesh_mtime, mesh_size);
+  std::string boundsName = std::string(this->GetFileName()) + ".bounds";
+  int loaded = loadElementBounds(boundsName, this->numBlocks, mesh_mtime, mesh_size, this->elementBounds) ? 1 : 0;
+  if(num_ranks > 1)
+  {
+    int all_loaded = 0;
+    ctrl->AllReduce(&loaded, &all_loaded, 1, vtkCommunicator::MIN_OP);
+    loaded = all_loaded;
+  }
+  if(loaded)
+  {
+    vtkDebugMacro(<< "updateElementBounds: bounds of " << this->numBlocks << " elements read from " << boundsName);
+    return;
+  }
 
-  if(this->precision == 4)
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  std::vector<vtkIdType> counts(num_ranks), firsts(num_ranks);
+  for(int r=0; r<num_ranks; r++)
+  {
+    counts[r] = this->numBlocks / num_ranks + (r < this->numBlocks % num_ranks ? 1 : 0);
+    firsts[r] = (r == 0) ? 0 : firsts[r-1] + counts[r-1];
+  }
+  int count = int(counts[my_rank]);
+  int first = int(firsts[my_rank]);
+  std::vector<int> positions(count);
+  for(int i=0; i<count; i++)
+  {
+    positions[i] = blockMap.find(elements[first+i])->second;
+  }
+  nek5KReadPlan plan;
+  plan.build(positions.data(), count);
+
+  // the X, Y (and Z) blocks of each element, converted one at a time
+  int num_coords = this->MeshIs3D ? 3 : 2;
+  long comp_size = long(this->fileBlockSize) * this->precision;
+  long block_size = comp_size * num_coords;
+  long base = 136 + long(this->numBlocks) * 4;
+  long max_run = std::max(1L, MAX_STAGING_BYTES / block_size);
+  std::unique_ptr<char[]> staging;
+  std::vector<float> bounds(6 * size_t(count));
+  nek5KReadStats stats;
+  for(const nek5KReadRun& run : plan.runs)
   {
-    float* coordPtr = this->meshCoords;
-    int read_size;
-    if(this->MeshIs3D)
+    int done = 0;
+    while(done < run.count)
+    {
+      long n = run.count - done;
+      if(!dataFile.mapping && n > max_run)
+        n = max_run;
+      if(!staging && !dataFile.mapping)
+        staging.reset(new char[std::min(long(count), max_run) * block_size]);
+      const char* buffer = dataFile.fetch(base + (run.position + done) * block_size, n * block_size, staging.get());
+      if(!buffer)
       {
-      read_size = this->totalBlockSize * 3;
-      for(i=0; i < this->myNumBlocks; i++)
-        {
-      // header + (index_of_this_block * size_of_a_block * variable_in_block (x,y,z) * precision)
-        offset1  = this->myBlockPositions[i];
-        offset1 *= this->totalBlockSize;
-        offset1 *= 3;
-        offset1 *= this->precision;
-        read_location = total_header_size + offset1;
-        dfPtr.seekg(read_location, std::ios_base::beg );
-        if (!dfPtr)
-          std::cerr << __LINE__ << ": seekg error at read_location = " << read_location << std::endl;
-        dfPtr.read( (char *)coordPtr, read_size*sizeof(float));
-        if (!dfPtr)
-          std::cerr << __LINE__ << ": read error\n";
-        coordPtr += read_size;
-       }
+        std::cerr << "Error reading the coordinates of the elements in : " << dfName << endl;
+        exit(1);
       }
-    else { // 2D case
-      read_size = this->totalBlockSize * 2;
-      for(i=0; i < this->myNumBlocks; i++)
+      stats.requests++;
+      stats.bytes += n * block_size;
+      const int* order = &plan.order[run.first + done];
+      vtkSMPTools::For(0, n, [&](vtkIdType begin, vtkIdType end) {
+        std::vector<double> values(this->fileBlockSize);
+        for(vtkIdType k = begin; k < end; k++)
         {
-        // header + (index_of_this_block * size_of_a_block * variable_in_block (x,y,z) * precision)
-        offset1  = this->myBlockPositions[i];
-        offset1 *= this->totalBlockSize;
-        offset1 *= 2;
-        offset1 *= this->precision;
-        read_location = total_header_size + offset1;
-        dfPtr.seekg(read_location, std::ios_base::beg );
-        if (!dfPtr)
-          std::cerr << __LINE__ << ": seekg error at read_location = " << read_location << std::endl; 
-        dfPtr.read( (char *)coordPtr, read_size*sizeof(float));
-      
-        if (!dfPtr)
-          std::cerr << __LINE__ << ": read error\n";
-        // now set the Z component to 0.0
-        memset(&coordPtr[read_size], 0, this->totalBlockSize * sizeof(float));
-        coordPtr += (this->totalBlockSize * 3);
+          float* b = &bounds[6 * size_t(order[k])];
+          for(int c = 0; c < 3; c++)
+          {
+            double lo = 0.0, hi = 0.0;
+            if(c < num_coords)
+            {
+              nek5KConvertValues(buffer + k * block_size + c * comp_size, this->fileBlockSize, this->precision,
+                                 this->swapEndian, values.data());
+              auto range = std::minmax_element(values.begin(), values.end());
+              lo = *range.first;
+              hi = *range.second;
+            }
+            // rounded outwards, so that the points are within the bounds
+            b[2*c] = floatBelow(lo);
+            b[2*c+1] = floatAbove(hi);
+          }
         }
+      });
+      done += n;
+    }
+  }
+  stats.per_element_requests += count;
+  this->addReadStats(stats);
+
+  if(num_ranks > 1)
+  {
+    std::vector<float> all_bounds(6 * size_t(this->numBlocks));
+    for(int r=0; r<num_ranks; r++)
+    {
+      counts[r] *= 6;
+      firsts[r] *= 6;
     }
+    ctrl->AllGatherV(bounds.data(), all_bounds.data(), 6 * vtkIdType(count), counts.data(), firsts.data());
+    bounds.swap(all_bounds);
+    first = 0;
+    count = this->numBlocks;
+  }
+  // in the order of the elements in the data files
+  this->elementBounds.resize(6 * size_t(this->numBlocks));
+  for(int i=0; i<count; i++)
+  {
+    int position = blockMap.find(elements[first+i])->second;
+    std::copy(&bounds[6 * size_t(i)], &bounds[6 * size_t(i)] + 6, &this->elementBounds[6 * size_t(position)]);
+  }
+  if(my_rank == 0)
+    saveElementBounds(boundsName, this->numBlocks, mesh_mtime, mesh_size, this->elementBounds);
+  timer->StopTimer();
+  vtkDebugMacro(<< "updateElementBounds: bounds of " << this->numBlocks << " elements in " << timer->GetElapsedTime());
+}// vtkNek5000Reader::updateElementBounds()
 
-    if(this->swapEndian)
-      ByteSwap32(this->meshCoords, this->myNumBlocks * this->totalBlockSize * 3);
+//----------------------------------------------------------------------------
+std::vector<double> vtkNek5000Reader::regionSettings()
+{
+  std::vector<double> settings;
+  if(this->RegionOfInterest == 1)
+  {
+    settings.assign(this->RegionBounds, this->RegionBounds + 6);
   }
-  else // precision == 8
+  else if(this->RegionOfInterest == 2)
   {
-    float* coordPtr = this->meshCoords;
-    double *tmpDblPts = new double[this->totalBlockSize * 3];
-    int read_size = this->totalBlockSize * 3;
-    for(i=0; i<this->myNumBlocks; i++)
+    settings.assign(this->RegionOrigin, this->RegionOrigin + 3);
+    settings.insert(settings.end(), this->RegionNormal, this->RegionNormal + 3);
+    settings.push_back(this->RegionThickness);
+  }
+  if(!settings.empty())
+    settings.insert(settings.begin(), this->RegionOfInterest);
+  return settings;
+}// vtkNek5000Reader::regionSettings()
+
+//----------------------------------------------------------------------------
+// In 2D, the elements are in the plane z = 0. A slab with a null normal
+// holds everything.
+bool vtkNek5000Reader::elementInRegion(const float* bounds)
+{
+  if(this->RegionOfInterest == 1)
+  {
+    for(int c = 0; c < 3; c++)
     {
-      // header + (index_of_this_block * size_of_a_block * variable_in_block (x,y,z) * precision)
-      read_location = total_header_size + int64_t(this->myBlockPositions[i] * this->totalBlockSize * 3 * this->precision );
-      //fseek(dfPtr, read_location, SEEK_SET);
-      //fread(tmpDblPts, sizeof(double), read_size, dfPtr);
-      dfPtr.seekg(read_location, std::ios_base::beg );
-      if (!dfPtr)
-        std::cerr << __LINE__ << ": seekg error at read_location = " << read_location << std::endl;
-      dfPtr.read( (char *)tmpDblPts, read_size*sizeof(double));
-      for(auto ind=0; ind<read_size; ind++)
-      {
-        *coordPtr = (float)tmpDblPts[ind];
-        coordPtr++;
-      }
+      if(bounds[2*c] > this->RegionBounds[2*c+1] || bounds[2*c+1] < this->RegionBounds[2*c])
+        return false;
     }
-    if(this->swapEndian)
-      ByteSwap64(this->meshCoords, this->myNumBlocks*this->totalBlockSize*3);
-    delete [] tmpDblPts;
+    return true;
   }
-  delete [] this->myBlockIDs;
-  dfPtr.close();
-}// void vtkNek5000Reader::partitionAndReadMesh()
+
+  // the distance of the center of the box to the plane, against the half
+  // extent of the box along the normal
+  double norm = std::sqrt(this->RegionNormal[0] * this->RegionNormal[0] + this->RegionNormal[1] * this->RegionNormal[1] +
+                          this->RegionNormal[2] * this->RegionNormal[2]);
+  if(norm == 0.0)
+    return true;
+  double distance = 0.0, extent = 0.0;
+  for(int c = 0; c < 3; c++)
+  {
+    double n = this->RegionNormal[c] / norm;
+    distance += n * (0.5 * (double(bounds[2*c]) + bounds[2*c+1]) - this->RegionOrigin[c]);
+    extent += std::fabs(n) * 0.5 * (double(bounds[2*c+1]) - bounds[2*c]);
+  }
+  return std::fabs(distance) <= extent + 0.5 * this->RegionThickness;
+}// vtkNek5000Reader::elementInRegion()
 
 //----------------------------------------------------------------------------
-int vtkNek5000Reader::RequestInformation(
-  vtkInformation* vtkNotUsed(request),
-  vtkInformationVector** vtkNotUsed(inputVector),
-  vtkInformationVector* outputVector)
+// Read the coordinates of my blocks from the data file of step 'step_index',
+// in the type of the output. They are kept as in the file, the X, Y and Z
+// blocks of each element one after the other, until copyContinuumPoints()
+// uses them.
+bool vtkNek5000Reader::readMeshCoords(int step_index)
 {
-  double timer_diff;
+  char dfName[265];
+  nek5KDataFile dataFile;
 
-  string tag;
-  char buf[2048];
+  sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start + step_index );
+  if (!dataFile.open(dfName, this->UseMemoryMap != 0, this->useCollectiveIO()))
+  {
+    std::cerr << "Error opening : " << dfName << endl;
+    exit(1);
+  }
+
+  if(this->meshCoords)
+    this->meshCoords->Delete();
+  vtkDebugMacro(<< ": readMeshCoords:  ALLOCATE meshCoords[" << this->myNumBlocks <<"*"<< this->totalBlockSize <<"*" <<3 << "]"
+                << (this->dataType == VTK_DOUBLE ? " doubles" : " floats"));
+  this->meshCoords = vtkDataArray::CreateDataArray(this->dataType);
+  this->meshCoords->SetNumberOfComponents(3);
+  this->meshCoords->SetNumberOfTuples(long(this->myNumBlocks) * this->totalBlockSize);
+
+  long total_header_size = 136 + (this->numBlocks * 4);
+  long l_blocksize;
+
+  // header + (index_of_this_block * size_of_a_block * variable_in_block (x,y,z) * precision)
+  // in 2D, only X and Y are stored, and readBlocks sets the Z component to 0.0
+  l_blocksize  = this->fileBlockSize;
+  l_blocksize *= (this->MeshIs3D ? 3 : 2);
+  l_blocksize *= this->precision;
+  nek5KReadStats stats;
+  nek5KReadSettings settings = this->readSettings();
+  bool ok;
+  if(this->dataType == VTK_DOUBLE)
+    ok = this->readBlocks(dataFile, settings, total_header_size, l_blocksize,
+                          static_cast<double*>(this->meshCoords->GetVoidPointer(0)), this->totalBlockSize * 3, stats);
+  else
+    ok = this->readBlocks(dataFile, settings, total_header_size, l_blocksize,
+                          static_cast<float*>(this->meshCoords->GetVoidPointer(0)), this->totalBlockSize * 3, stats);
+  this->addReadStats(stats);
+
+  dataFile.close();
+  if(!ok)
+    vtkErrorMacro(<< "Error reading the coordinates in : " << dfName);
+  return ok;
+}// vtkNek5000Reader::readMeshCoords()
+
+//----------------------------------------------------------------------------
+// The step whose data file holds the coordinates of step 'step_index': the
+// step itself if its file includes the mesh, otherwise the last one before it
+// that does, or the first step. The answers are kept, so that the headers the
+// search reads with FastOpen are read once; then only rank 0 reads them, and
+// gives the other ranks what it found.
+int vtkNek5000Reader::meshStepOf(int step_index)
+{
+  if(this->timestep_mesh_step[step_index] >= 0)
+    return this->timestep_mesh_step[step_index];
 
   int num_ranks, my_rank;
   vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
   if (ctrl != nullptr)
+  {
+    num_ranks = ctrl->GetNumberOfProcesses();
+    my_rank = ctrl->GetLocalProcessId();
+  }
+  else
+  {
+    num_ranks = 1;
+    my_rank = 0;
+  }
+  bool shared = (this->FastOpen && num_ranks > 1);
+
+  // found[0] is the mesh step, found[1] the first step of the search which
+  // tells it: the steps after it, up to step_index, have no mesh
+  int found[2] = { 0, 0 };
+  if(0 == my_rank || !shared)
+  {
+    for(int s = step_index; s > 0; s--)
     {
-      num_ranks = ctrl->GetNumberOfProcesses();
-      my_rank = ctrl->GetLocalProcessId();
-    }
-    else
-    {
-      num_ranks = 1;
-      my_rank = 0;
+      if(this->timestep_mesh_step[s] >= 0)
+      {
+        found[0] = this->timestep_mesh_step[s];
+        found[1] = s;
+        break;
+      }
+      if(this->stepHasMesh(s))
+      {
+        found[0] = found[1] = s;
+        break;
+      }
     }
+  }
+  if(shared)
+    ctrl->Broadcast(found, 2, 0);
 
-  if(!this->IAM_INITIALLIZED)
+  for(int s = found[1]; s <= step_index; s++)
+  {
+    this->timestep_mesh_step[s] = found[0];
+    if(s > found[0])
     {
-    // Might consider having just the master node read the .nek5000 file, and broadcast each line to the other processes ??
-
-    char* filename = this->GetFileName();
-    std::ifstream inPtr(this->GetFileName());
-    
-    //print the name of the file we're supposed to open
-    vtkDebugMacro(<< "vtkNek5000Reader::RequestInformation: FileName: " << this->GetFileName());
+      this->timestep_has_mesh[s] = false;
+      this->timestep_mesh_known[s] = true;
+    }
+  }
+  if(found[0] > 0)
+  {
+    this->timestep_has_mesh[found[0]] = true;
+    this->timestep_mesh_known[found[0]] = true;
+  }
+  return found[0];
+}// vtkNek5000Reader::meshStepOf()
+
+//----------------------------------------------------------------------------
+// Give curObj the points of its step. They are shared with a cached step
+// whose coordinates come from the same file, or else read, and still shared
+// with a cached step if they turn out identical to its own. The points of
+// the other readers of the process are used the same way. The cells are not
+// touched: they do not depend on the coordinates.
+bool vtkNek5000Reader::updateStepPoints()
+{
+  int mesh_step = this->meshStepOf(this->ActualTimeStep);
+  if(this->curObj->points && this->curObj->mesh_step == mesh_step)
+    return true;
+
+  nek5KObject* same = this->myCache->findIf([mesh_step](const nek5KObject& obj) {
+    return obj.points && obj.mesh_step == mesh_step;
+  });
+  // the points of the first mesh may come from the geometry cache file
+  vtkPoints* points = nullptr;
+  if(!same && mesh_step == 0 && this->geometryPoints &&
+     this->geometryPoints->GetData()->GetDataType() == this->dataType)
+  {
+    points = this->geometryPoints;
+    points->Register(nullptr);
+  }
+  // or be those another reader of the process read from the same file
+  std::string source = this->pointsSource(mesh_step);
+  if(!same && !points)
+  {
+    points = this->findSharedPoints(source, nullptr, 0);
+  }
+  int need_read = (!same && !points);
+  if(this->useCollectiveIO())
+  {
+    // the ranks read the coordinates together when any of them has to
+    MPI_Allreduce(MPI_IN_PLACE, &need_read, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  }
+
+  size_t hash = 0;
+  if(need_read)
+  {
+    if(!this->readMeshCoords(mesh_step))
+    {
+      if(points)
+        points->Delete();
+      return false;
+    }
+    vtkPoints* read_points = vtkPoints::New();
+    this->copyContinuumPoints(read_points);
+    if(points)
+      read_points->Delete();
+    else
+      points = read_points;
+  }
+  if(points)
+  {
+    hash = hashPoints(points->GetData());
+    if(!same)
+    {
+      same = this->myCache->findIf([&](const nek5KObject& obj) {
+        return obj.points && obj.points_hash == hash && samePoints(obj.points->GetData(), points->GetData());
+      });
+    }
+    if(!same)
+    {
+      // identical to the points of another reader, from another file
+      vtkPoints* shared = this->findSharedPoints(source, points, hash);
+      if(shared)
+      {
+        points->Delete();
+        points = shared;
+      }
+    }
+  }
+
+  if(this->curObj->points)
+    this->curObj->points->Delete();
+  if(same)
+  {
+    vtkDebugMacro(<< "updateStepPoints: the points of step " << mesh_step << " are those of step " << same->mesh_step);
+    if(points)
+      points->Delete();
+    this->curObj->points = same->points;
+    this->curObj->points->Register(nullptr);
+    this->curObj->points_hash = same->points_hash;
+    this->curObj->owns_points = false;
+  }
+  else
+  {
+    this->curObj->points = points;
+    this->curObj->points_hash = hash;
+    this->curObj->owns_points = true;
+  }
+  this->curObj->mesh_step = mesh_step;
+  this->registerPoints(source, this->curObj->points, this->curObj->points_hash);
+
+  // the grid of the step, if any, was made with other points
+  if(this->curObj->ugrid)
+  {
+    this->curObj->ugrid->Delete();
+    this->curObj->ugrid = nullptr;
+  }
+  return true;
+}// vtkNek5000Reader::updateStepPoints()
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+// Read all blocks of the read plan of 'settings'. Block b of the file starts at
+// base + b*block_size, local block j is stored at dest + j*dest_stride.
+// Each run of blocks adjacent in the file is fetched with one request,
+// straight into dest when the layout allows, otherwise through a staging
+// buffer (or the file mapping) from which the blocks are scattered. Values
+// are byte-swapped if needed and converted to T in the same pass, and a
+// destination block longer than a file block (2D vectors and coordinates)
+// is padded with zeros. With a stride, a request spans from the first row
+// kept of its first block to the last row kept of its last block.
+template <class T>
+bool vtkNek5000Reader::readBlocks(nek5KDataFile& dataFile, const nek5KReadSettings& settings, long base,
+                                  long block_size, T* dest, long dest_stride, nek5KReadStats& stats)
+{
+  long num_vals = block_size / this->precision;
+  bool same_layout = (this->precision == int(sizeof(T)) && num_vals == dest_stride &&
+                      settings.totalBlockSize == this->fileBlockSize);
+  long max_run = std::max(1L, MAX_STAGING_BYTES / block_size);
+  std::unique_ptr<char[]> staging;
+  // the bytes before the first row kept of a block and after the last one
+  long head = 0, tail = 0;
+  if(!settings.sampledRuns.empty())
+  {
+    const std::pair<long,long>& last = settings.sampledRuns.back();
+    head = settings.sampledRuns.front().first * this->precision;
+    tail = (this->fileBlockSize - last.first - last.second) * this->precision;
+  }
+
+  if(dataFile.collective)
+  {
+    // my blocks, in file order, are read in chunks of at most max_run blocks,
+    // one request per chunk, which the MPI-IO layer aggregates with the
+    // requests of the other ranks. All ranks issue as many requests.
+    const std::vector<nek5KReadRun>& runs = settings.readPlan.runs;
+    bool direct = same_layout && runs.size() == 1 && runs[0].direct;
+    long num_blocks = this->myNumBlocks;
+    long num_chunks = (num_blocks + max_run - 1) / max_run;
+    MPI_Allreduce(MPI_IN_PLACE, &num_chunks, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+    if(!direct)
+      staging.reset(new char[std::min(num_blocks, max_run) * block_size]);
+    int ok = 1;
+    for(long chunk = 0; chunk < num_chunks; chunk++)
+    {
+      long first = std::min(chunk * max_run, num_blocks);
+      long count = std::min(max_run, num_blocks - first);
+      char* buffer = direct ? (char*)(dest + (settings.readPlan.order[0] + first) * dest_stride) : staging.get();
+      if(!dataFile.readAll(settings.readPlan, first, count, base, block_size, buffer))
+      {
+        ok = 0;
+        continue;
+      }
+      stats.requests++;
+      stats.bytes += count * block_size;
+      if(direct)
+      {
+        if(this->swapEndian)
+          nek5KConvertValues(buffer, count * num_vals, this->precision, true, (T*)buffer);
+        continue;
+      }
+      const int* order = settings.readPlan.order.data() + first;
+      vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+        std::vector<double> scratch;
+        for(vtkIdType k = begin; k < end; k++)
+        {
+          this->storeBlock(settings, buffer + k * block_size, num_vals, dest + order[k] * dest_stride, dest_stride,
+                           scratch);
+        }
+      });
+    }
+    stats.per_element_requests += num_blocks;
+    // the ranks fail together, or those left would wait in the requests of the next variable
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return ok != 0;
+  }
+
+  for(const nek5KReadRun& run : settings.readPlan.runs)
+  {
+    bool direct = same_layout && run.direct;
+    int done = 0;
+    while(done < run.count)
+    {
+      long count = run.count - done;
+      if(!direct && !dataFile.mapping && count > max_run)
+        count = max_run;
+
+      const int* order = &settings.readPlan.order[run.first + done];
+      long read_location = base + (run.position + done) * block_size;
+      long read_bytes = count * block_size;
+      stats.requests++;
+
+      if(direct)
+      {
+        T* dst = dest + order[0] * dest_stride;
+        stats.bytes += read_bytes;
+        if(!dataFile.read(read_location, read_bytes, (char*)dst))
+          return false;
+        if(this->swapEndian)
+          nek5KConvertValues((const char*)dst, count * num_vals, this->precision, true, dst);
+      }
+      else
+      {
+        if(!staging && !dataFile.mapping)
+          staging.reset(new char[std::min(long(this->myNumBlocks), max_run) * block_size]);
+        // the blocks start 'head' bytes before the values fetched, in the
+        // staging buffer as in the mapping
+        stats.bytes += read_bytes - head - tail;
+        const char* buffer = dataFile.fetch(read_location + head, read_bytes - head - tail,
+                                            staging ? staging.get() + head : nullptr);
+        if(!buffer)
+          return false;
+        buffer -= head;
+        // the blocks are converted, and resampled, by all threads
+        vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+          std::vector<double> scratch;
+          for(vtkIdType k = begin; k < end; k++)
+          {
+            this->storeBlock(settings, buffer + k * block_size, num_vals, dest + order[k] * dest_stride, dest_stride,
+                             scratch);
+          }
+        });
+      }
+      done += count;
+    }
+  }
+  stats.per_element_requests += this->myNumBlocks;
+  return true;
+}// vtkNek5000Reader::readBlocks()
+
+//----------------------------------------------------------------------------
+// Apply the matrices 'J', of m[d] rows of n[d] values, to the n[0]*n[1]*n[2]
+// values of 'in', x fastest, one direction after the other, into the
+// m[0]*m[1]*m[2] values of 'out'. 'work' holds the values between the steps.
+template <class T>
+static void applyTensorProduct(const double* in, T* out, const int* n, const int* m,
+                               const std::vector<double>* J, double* work)
+{
+  double* tx = work;                          // m[0] x n[1] x n[2]
+  double* ty = work + long(m[0]) * n[1] * n[2]; // m[0] x m[1] x n[2]
+  for(long kj = 0; kj < long(n[1]) * n[2]; kj++)
+  {
+    for(int a = 0; a < m[0]; a++)
+    {
+      double v = 0.0;
+      for(int i = 0; i < n[0]; i++)
+        v += J[0][a * n[0] + i] * in[kj * n[0] + i];
+      tx[kj * m[0] + a] = v;
+    }
+  }
+  for(int k = 0; k < n[2]; k++)
+  {
+    for(int b = 0; b < m[1]; b++)
+    {
+      for(int a = 0; a < m[0]; a++)
+      {
+        double v = 0.0;
+        for(int j = 0; j < n[1]; j++)
+          v += J[1][b * n[1] + j] * tx[(long(k) * n[1] + j) * m[0] + a];
+        ty[(long(k) * m[1] + b) * m[0] + a] = v;
+      }
+    }
+  }
+  for(int c = 0; c < m[2]; c++)
+  {
+    for(long ba = 0; ba < long(m[1]) * m[0]; ba++)
+    {
+      double v = 0.0;
+      for(int k = 0; k < n[2]; k++)
+        v += J[2][c * n[2] + k] * ty[long(k) * m[1] * m[0] + ba];
+      out[c * m[1] * m[0] + ba] = static_cast<T>(v);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// A file block holds the values of each component of the points of an
+// element one after the other. With a stride, only the runs of rows holding
+// the points kept are converted, see updateElementSampling(). With a projection,
+// each component is interpolated as a whole.
+template <class T>
+void vtkNek5000Reader::storeBlock(const nek5KReadSettings& settings, const char* src, long num_vals, T* dst, long dest_stride,
+                                  std::vector<double>& scratch)
+{
+  long stored = num_vals;
+  if(settings.totalBlockSize == this->fileBlockSize)
+  {
+    nek5KConvertValues(src, num_vals, this->precision, this->swapEndian, dst);
+  }
+  else if(!settings.projection[0].empty())
+  {
+    long num_comps = num_vals / this->fileBlockSize;
+    scratch.resize(num_vals + 2 * long(settings.blockDims[0]) * this->fileBlockDims[1] * this->fileBlockDims[2]);
+    nek5KConvertValues(src, num_vals, this->precision, this->swapEndian, scratch.data());
+    for(long c = 0; c < num_comps; c++)
+    {
+      applyTensorProduct(scratch.data() + c * this->fileBlockSize, dst + c * settings.totalBlockSize,
+                         this->fileBlockDims, settings.blockDims, settings.projection, scratch.data() + num_vals);
+    }
+    stored = num_comps * settings.totalBlockSize;
+  }
+  else
+  {
+    long num_comps = num_vals / this->fileBlockSize;
+    const std::vector<long>& kept = settings.sampledPoints;
+    long num_kept = static_cast<long>(kept.size());
+    for(long c = 0; c < num_comps; c++)
+    {
+      const char* comp = src + c * this->fileBlockSize * this->precision;
+      long p = 0;
+      for(const std::pair<long,long>& run : settings.sampledRuns)
+      {
+        scratch.resize(run.second);
+        nek5KConvertValues(comp + run.first * this->precision, run.second, this->precision, this->swapEndian,
+                           scratch.data());
+        for(; p < num_kept && kept[p] < run.first + run.second; p++)
+          dst[c * num_kept + p] = static_cast<T>(scratch[kept[p] - run.first]);
+      }
+    }
+    stored = num_comps * num_kept;
+  }
+  if(dest_stride > stored)
+    memset(dst + stored, 0, (dest_stride - stored) * sizeof(T));
+}// vtkNek5000Reader::storeBlock()
+
+//----------------------------------------------------------------------------
+// The n Gauss-Lobatto-Legendre points of [-1,1]: the ends, and the roots of
+// the derivative of the Legendre polynomial of degree n-1, found by Newton
+// iterations from the Chebyshev points.
+static std::vector<double> gllPoints(int n)
+{
+  if(n == 1)
+    return std::vector<double>(1, 0.0);
+  std::vector<double> x(n);
+  const int N = n - 1;
+  const double pi = std::acos(-1.0);
+  for(int i = 0; i < n; i++)
+  {
+    double xi = -std::cos(pi * i / N), previous;
+    int iterations = 0;
+    do
+    {
+      // Legendre polynomials of degree N-1 and N at xi
+      double p0 = 1.0, p1 = xi;
+      for(int k = 2; k <= N; k++)
+      {
+        double p2 = ((2*k - 1) * xi * p1 - (k - 1) * p0) / k;
+        p0 = p1;
+        p1 = p2;
+      }
+      previous = xi;
+      xi = previous - (xi * p1 - p0) / ((N + 1) * p1);
+    } while(std::fabs(xi - previous) > 1e-15 && ++iterations < 100);
+    x[i] = xi;
+  }
+  return x;
+}
+
+// The matrix of m rows of n values interpolating the values at n GLL points
+// to m GLL points, with the Lagrange polynomials of the n points.
+static std::vector<double> gllInterpolation(int n, int m)
+{
+  std::vector<double> from = gllPoints(n), to = gllPoints(m);
+  std::vector<double> J(long(m) * n);
+  for(int a = 0; a < m; a++)
+  {
+    for(int j = 0; j < n; j++)
+    {
+      double l = 1.0;
+      for(int k = 0; k < n; k++)
+      {
+        if(k != j)
+          l *= (to[a] - from[k]) / (from[j] - from[k]);
+      }
+      J[long(a) * n + j] = l;
+    }
+  }
+  return J;
+}
+
+//----------------------------------------------------------------------------
+// With a ProjectionOrder lower than that of the files, the elements are
+// interpolated to its GLL points. Otherwise every ElementStride-th point of
+// the elements is kept in each direction, and the last one. The elements are
+// output with blockDims points.
+void vtkNek5000Reader::updateElementSampling()
+{
+  this->element_stride = this->ElementStride;
+  this->projection_order = this->ProjectionOrder;
+  this->sampledPoints.clear();
+  this->sampledRuns.clear();
+  for(int d = 0; d < 3; d++)
+    this->projection[d].clear();
+
+  if(this->projection_order > 0 && this->projection_order + 1 < this->fileBlockDims[0])
+  {
+    for(int d = 0; d < 3; d++)
+    {
+      int n = this->fileBlockDims[d];
+      this->blockDims[d] = (n > 1) ? this->projection_order + 1 : 1;
+      this->projection[d] = gllInterpolation(n, this->blockDims[d]);
+    }
+    this->totalBlockSize = this->blockDims[0] * this->blockDims[1] * this->blockDims[2];
+    vtkDebugMacro(<< "updateElementSampling: elements projected to order " << this->projection_order);
+    return;
+  }
+
+  std::vector<long> kept[3];
+  for(int d = 0; d < 3; d++)
+  {
+    int n = this->fileBlockDims[d];
+    int step = (this->element_stride == 0) ? n-1 : this->element_stride;
+    if(step <= 1 || n <= 2)
+      step = 1;
+    for(int i = 0; i < n-1; i += step)
+      kept[d].push_back(i);
+    kept[d].push_back(n-1);
+    this->blockDims[d] = static_cast<int>(kept[d].size());
+  }
+  this->totalBlockSize = this->blockDims[0] * this->blockDims[1] * this->blockDims[2];
+
+  if(this->totalBlockSize != this->fileBlockSize)
+  {
+    for(long k : kept[2])
+      for(long j : kept[1])
+        for(long i : kept[0])
+          this->sampledPoints.push_back((k * this->fileBlockDims[1] + j) * this->fileBlockDims[0] + i);
+    // the rows holding them, from their first to their last point, joined when adjacent
+    for(long k : kept[2])
+    {
+      for(long j : kept[1])
+      {
+        long first = (k * this->fileBlockDims[1] + j) * this->fileBlockDims[0] + kept[0].front();
+        long count = kept[0].back() - kept[0].front() + 1;
+        if(!this->sampledRuns.empty() &&
+           this->sampledRuns.back().first + this->sampledRuns.back().second == first)
+          this->sampledRuns.back().second += count;
+        else
+          this->sampledRuns.push_back(std::make_pair(first, count));
+      }
+    }
+  }
+  vtkDebugMacro(<< "updateElementSampling: elements of " << this->blockDims[0] << "x" << this->blockDims[1]
+                << "x" << this->blockDims[2] << " points");
+}// vtkNek5000Reader::updateElementSampling()
+
+//----------------------------------------------------------------------------
+// A variable can be used in place if it is stored in the precision of the
+// output, with the native byte order, not read with collective requests, all my blocks are one run in the file, and it is a scalar
+// or a 3D vector kept in the per-element layout of the file. The run must
+// also be aligned for its values: the mapping starts on a page, but the
+// values follow a header of 136 + 4*numBlocks bytes, so that doubles are
+// misaligned when the number of elements is odd.
+bool vtkNek5000Reader::canMapVariable(nek5KDataFile& dataFile, const nek5KReadSettings& settings, int i, long offset,
+                                      long block_size)
+{
+  return dataFile.mapping && !dataFile.collective && this->precision == (settings.dataType == VTK_DOUBLE ? 8 : 4) && !this->swapEndian &&
+         settings.totalBlockSize == this->fileBlockSize &&
+         (this->var_length[i] == 1 || (settings.blockedVectors && this->MeshIs3D)) &&
+         settings.readPlan.runs.size() == 1 && settings.readPlan.runs[0].direct &&
+         (offset + settings.readPlan.runs[0].position * block_size) % this->precision == 0;
+}
+
+//----------------------------------------------------------------------------
+// MPI-IO is used if it was asked for, and MPI runs the ranks of the global
+// controller. All ranks come to the same answer.
+bool vtkNek5000Reader::useCollectiveIO()
+{
+  if(!this->UseMPIIO)
+    return false;
+
+  int initialized = 0, finalized = 0;
+  MPI_Initialized(&initialized);
+  MPI_Finalized(&finalized);
+  if(!initialized || finalized)
+    return false;
+
+  int num_ranks = 1, mpi_size = 1;
+  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
+  if (ctrl != nullptr)
+  {
+    num_ranks = ctrl->GetNumberOfProcesses();
+  }
+  MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+  return num_ranks == mpi_size;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeBool vtkNek5000Reader::ProcessRequest(vtkInformation* request,
+                                             vtkInformationVector** inputVector,
+                                             vtkInformationVector* outputVector)
+{
+  if(request->Has(vtkDemandDrivenPipeline::REQUEST_DATA_OBJECT()))
+  {
+    return this->RequestDataObject(request, inputVector, outputVector);
+  }
+  return this->Superclass::ProcessRequest(request, inputVector, outputVector);
+}
+
+//----------------------------------------------------------------------------
+int vtkNek5000Reader::FillOutputPortInformation(int vtkNotUsed(port), vtkInformation* info)
+{
+  // made by RequestDataObject(), after the type of output chosen
+  info->Set(vtkDataObject::DATA_TYPE_NAME(), "vtkDataObject");
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkNek5000Reader::RequestDataObject(vtkInformation* vtkNotUsed(request),
+                                        vtkInformationVector** vtkNotUsed(inputVector),
+                                        vtkInformationVector* outputVector)
+{
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+  vtkDataObject* output = vtkDataObject::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+  int type = this->StructuredOutput ? VTK_PARTITIONED_DATA_SET : VTK_UNSTRUCTURED_GRID;
+  if(!output || output->GetDataObjectType() != type)
+  {
+    vtkDataObject* newOutput;
+    if(this->StructuredOutput)
+      newOutput = vtkPartitionedDataSet::New();
+    else
+      newOutput = vtkUnstructuredGrid::New();
+    outInfo->Set(vtkDataObject::DATA_OBJECT(), newOutput);
+    newOutput->Delete();
+  }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkNek5000Reader::RequestInformation(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** vtkNotUsed(inputVector),
+  vtkInformationVector* outputVector)
+{
+  double timer_diff;
+
+  string tag;
+  char buf[2048];
+
+  int num_ranks, my_rank;
+  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
+  if (ctrl != nullptr)
+    {
+      num_ranks = ctrl->GetNumberOfProcesses();
+      my_rank = ctrl->GetLocalProcessId();
+    }
+    else
+    {
+      num_ranks = 1;
+      my_rank = 0;
+    }
+
+  if(!this->IAM_INITIALLIZED)
+    {
+    // the prefetch thread reads with the variables set up here
+    this->discardPrefetchedSteps();
+
+    // Might consider having just the master node read the .nek5000 file, and broadcast each line to the other processes ??
+
+    char* filename = this->GetFileName();
+    std::ifstream inPtr(this->GetFileName());
+    
+    //print the name of the file we're supposed to open
+    vtkDebugMacro(<< "vtkNek5000Reader::RequestInformation: FileName: " << this->GetFileName());
 
      // Process a tag at a time until all lines have been read
     while (inPtr.good())
@@ -1070,6 +2672,18 @@ int vtkNek5000Reader::RequestInformation(
         inPtr >> this->datafile_start;
         vtkDebugMacro(<< "vtkNek5000Reader::RequestInformation:  this->datafile_start: " <<  this->datafile_start);
         }
+      else if (strcasecmp("times:", tag.c_str())==0)
+        {
+        // optional, the times of all steps, used by FastOpen
+        string times_line;
+        std::getline(inPtr, times_line);
+        std::istringstream times(times_line);
+        double time;
+        this->listed_times.clear();
+        while (times >> time)
+          this->listed_times.push_back(time);
+        vtkDebugMacro(<< "vtkNek5000Reader::RequestInformation:  " << this->listed_times.size() << " times listed");
+        }
       else if (strcasecmp("numtimesteps:", tag.c_str())==0)
         {
         inPtr >> this->datafile_num_steps;
@@ -1119,6 +2733,12 @@ int vtkNek5000Reader::RequestInformation(
     vtkDebugMacro(<< "vtkNek5000Reader::RequestInformation:  this->datafile_format: " << this->datafile_format);
 
     this->NumberOfTimeSteps = this->datafile_num_steps;
+    if(this->NumberOfTimeSteps < 1)
+    {
+      vtkErrorMacro(<< "No time step in " << filename << ", numtimesteps is " << this->datafile_num_steps);
+      this->NumberOfTimeSteps = 0;
+      return 0;
+    }
 
     // GetAllTimes() now also calls GetVariableNamesFromData()
     vtkNew<vtkTimerLog> timer;
@@ -1258,36 +2878,96 @@ int vtkNek5000Reader::RequestData(
   vtkDebugMacro(<<"RequestData: ENTER: rank: "<< my_rank << "  outputPort: "
                 << outputPort << "  this->ActualTimeStep = "<< this->ActualTimeStep);
 
-  vtkUnstructuredGrid* ugrid = vtkUnstructuredGrid::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+  vtkDataObject* output = vtkDataObject::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+  vtkUnstructuredGrid* ugrid = vtkUnstructuredGrid::SafeDownCast(output);
+  // with StructuredOutput, no cells are made
+  vtkPartitionedDataSet* partitioned = vtkPartitionedDataSet::SafeDownCast(output);
 //  vtkUnstructuredGrid* boundary_ugrid = vtkUnstructuredGrid::SafeDownCast(outInfo1->Get(vtkDataObject::DATA_OBJECT()));
 
   // Save the time value in the output (ugrid) data information.
   if (steps)
   {
-    ugrid->GetInformation()->Set(vtkDataObject::DATA_TIME_STEP(),
-                                 steps[this->ActualTimeStep]);
+    output->GetInformation()->Set(vtkDataObject::DATA_TIME_STEP(),
+                                  steps[this->ActualTimeStep]);
   }
 
 //  int new_rst_val = this->p_rst_start + (this->p_rst_inc* this->ActualTimeStep);
   this->requested_step = this->datafile_start + this->ActualTimeStep;
+  // tells all ranks whether the file of the step includes the mesh, before
+  // they read it or not
+  this->meshStepOf(this->ActualTimeStep);
 
   //  if the step being displayed is different than the one requested
   //if(this->displayed_step != this->requested_step)
   {
     // get the requested object from the list, if the ugrid in the object is NULL
     // then we have not loaded it yet
-    this->curObj = this->myList->getObject(this->requested_step);
-
-    if(this->isObjectMissingData())
+    // if the precision of the output was changed, the grids and arrays in memory are of the former type
+    if(!this->READ_GEOM_FLAG && this->outputDataType() != this->dataType)
+    {
+      this->myCache->clear();
+      this->releaseDataArrays();
+      this->I_HAVE_DATA = false;
+      // the cells are kept, the points of the steps are read again in the new type
+      this->dataType = this->outputDataType();
+    }
+    // if the points kept of each element were changed, everything is read and made again
+    if(!this->READ_GEOM_FLAG && (this->ElementStride != this->element_stride ||
+                                 this->ProjectionOrder != this->projection_order))
+    {
+      this->discardPrefetchedSteps();
+      this->myCache->clear();
+      this->releaseDataArrays();
+      this->I_HAVE_DATA = false;
+      this->updateElementSampling();
+      this->CALC_GEOM_FLAG = true;
+      this->geometry_saved = false;
+      if(this->geometryPoints)
+      {
+        this->geometryPoints->Delete();
+        this->geometryPoints = nullptr;
+      }
+    }
+    // if the region of interest was changed, the elements are partitioned again and everything is read again
+    if(!this->READ_GEOM_FLAG && this->regionSettings() != this->region_applied)
     {
-      // if the step in memory is different than the step requested
-      if(this->requested_step != this->memory_step)
+      this->discardPrefetchedSteps();
+      this->myCache->clear();
+      this->releaseDataArrays();
+      this->I_HAVE_DATA = false;
+      this->READ_GEOM_FLAG = true;
+      this->CALC_GEOM_FLAG = true;
+      this->geometry_saved = false;
+      if(this->geometryPoints)
       {
-        this->I_HAVE_DATA = false;
+        this->geometryPoints->Delete();
+        this->geometryPoints = nullptr;
       }
     }
+    // if the kind of cells was changed, they are made again, the arrays and points are kept
+    if(!this->READ_GEOM_FLAG && this->useHighOrderCells() != this->high_order_cells)
+    {
+      this->myCache->releaseGrids();
+      this->CALC_GEOM_FLAG = true;
+      this->geometry_saved = false;
+    }
+    this->curObj = this->myCache->getObject(this->requested_step);
+
+    // only the arrays selected which are not cached yet are read
+    this->I_HAVE_DATA = !this->isObjectMissingData();
+    // with collective reads, the ranks read when any of them needs to
+    if(this->useCollectiveIO())
+    {
+      int missing = !this->I_HAVE_DATA;
+      MPI_Allreduce(MPI_IN_PLACE, &missing, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+      this->I_HAVE_DATA = !missing;
+    }
   }
 
+  this->NumberOfReadRequests = 0;
+  this->NumberOfBytesRead = 0;
+  this->NumberOfPerElementReadRequests = 0;
+
   // if I have not yet read the geometry, this should only happen once
   if(this->READ_GEOM_FLAG)
   {
@@ -1296,42 +2976,76 @@ int vtkNek5000Reader::RequestData(
   }
   if(!this->I_HAVE_DATA)
   {
-    // See if we have allocated memory to store the data from disk, if not, allocate it
-    if(!this->dataArray)
-      {
-      this->dataArray = new float*[this->num_vars];
-// only allocate data array if the varname has been selected
-      for(i=0; i<this->num_vars; i++)
-        {
-        if(this->use_variable[i])
-          {
-          this->dataArray[i] = new float[this->myNumBlocks * this->totalBlockSize * this->var_length[i]];
-          }
-        else
-          {
-          this->dataArray[i] = nullptr;
-          }
-        }
-      }
-
     // Get the file name for requested time step
 
     sprintf(dfName, this->datafile_format.c_str(), 0, this->requested_step);
     vtkDebugMacro(<<"vtkNek5000Reader::RequestData: Rank: "<< my_rank<<" Now reading data from file: "<< dfName<<" this->requested_step: "<< this->requested_step);
 
-    this->readData(dfName);
+    if(this->takePrefetchedStep())
+    {
+      vtkDebugMacro(<<"vtkNek5000Reader::RequestData: Rank: "<< my_rank<<" step "<< this->requested_step<<" was read ahead");
+    }
+    else
+    {
+      if(!this->readData(dfName))
+        return 0;
+    }
 
+    this->cacheDataArrays();
     this->curObj->setDataFilename(dfName);
 
+    vtkDebugMacro(<<"vtkNek5000Reader::RequestData: Rank: "<< my_rank<<" read "<< this->NumberOfBytesRead
+                  <<" bytes in "<< this->NumberOfReadRequests<<" requests (one request per element: "
+                  << this->NumberOfPerElementReadRequests<<")");
+
     this->I_HAVE_DATA = true;
     this->memory_step = this->requested_step;
 
   } // if(!this->I_HAVE_DATA)
+  else if(!this->curObj->dataFilename)
+  {
+    // no array was needed, a step showing the mesh only
+    sprintf(dfName, this->datafile_format.c_str(), 0, this->requested_step);
+    this->curObj->setDataFilename(dfName);
+  }
 
-  this->updateVtuData(ugrid); //, boundary_ugrid); // , outputPort);
+  // the cells, made once, and the points of the step, read if its mesh is not cached
+  if(this->CALC_GEOM_FLAG && !partitioned)
+    this->updateCells();
+  if(!this->updateStepPoints())
+    return 0;
+
+  if(partitioned)
+  {
+    this->updatePartitions(partitioned);
+  }
+  else
+  {
+    this->updateVtuData(ugrid); //, boundary_ugrid); // , outputPort);
+    std::vector<char> keep;
+    if(this->selectValueElements(keep))
+      this->keepElementCells(ugrid, keep);
+    if(this->GeometryCache && !this->geometry_saved && this->curObj->mesh_step == 0)
+    {
+      this->saveGeometry(this->curObj->points);
+      this->geometry_saved = true;
+    }
+  }
+  this->updatePeakMemory(ugrid);
+  if(this->LowMemory && this->CleanGrid && ugrid)
+  {
+    // the merged grid of the output is the only copy kept
+    this->curObj->releaseData();
+  }
+  // account for the arrays of this step, and keep the cache within its budget
+  this->myCache->update(this->curObj,
+                        this->LowMemory ? 0 : static_cast<vtkIdType>(this->CacheSize) * 1024 * 1024);
 
   this->SetDataFileName(this->curObj->dataFilename);
 
+  // read the next steps while this one is shown
+  this->schedulePrefetch();
+
   total_timer->StopTimer();
   total_timer_diff = total_timer->GetElapsedTime();
 
@@ -1339,10 +3053,162 @@ int vtkNek5000Reader::RequestData(
   return 1;
 } // vtkNek5000Reader::RequestData()
 
-void vtkNek5000Reader::updateVtuData(vtkUnstructuredGrid* pv_ugrid)
+//----------------------------------------------------------------------------
+// Each of my elements is a structured grid of its points. They use the points
+// and arrays of curObj in place, which stay alive as long as any of them.
+void vtkNek5000Reader::updatePartitions(vtkPartitionedDataSet* output)
 {
-  double timer_diff;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  int dims[3] = { this->blockDims[0], this->blockDims[1], this->MeshIs3D ? this->blockDims[2] : 1 };
+  vtkDataArray* coords = this->curObj->points->GetData();
+  std::vector<char> keep;
+  bool selected = this->selectValueElements(keep);
+  output->Initialize();
+  output->SetNumberOfPartitions(selected ? int(std::count(keep.begin(), keep.end(), 1)) : this->myNumBlocks);
+  int num_pieces = 0;
+  for(auto e = 0; e < this->myNumBlocks; ++e)
+  {
+    if(selected && !keep[e])
+      continue;
+    vtkNew<vtkStructuredGrid> piece;
+    piece->SetDimensions(dims);
+    vtkNew<vtkPoints> points;
+    vtkDataArray* piece_coords = (this->dataType == VTK_DOUBLE) ?
+      aliasBlock<double>(coords, e, this->totalBlockSize) : aliasBlock<float>(coords, e, this->totalBlockSize);
+    points->SetData(piece_coords);
+    piece_coords->Delete();
+    piece->SetPoints(points);
+
+    for(auto v_index=0; v_index < this->num_vars; v_index++)
+    {
+      vtkDataArray* array = this->curObj->arrays[v_index];
+      if(this->use_variable[v_index] && array)
+      {
+        vtkDataArray* piece_array = (array->GetDataType() == VTK_DOUBLE) ?
+          aliasBlock<double>(array, e, this->totalBlockSize) : aliasBlock<float>(array, e, this->totalBlockSize);
+        piece->GetPointData()->AddArray(piece_array);
+        piece_array->Delete();
+      }
+    }
+    if(this->SpectralElementIds)
+    {
+      vtkNew<vtkTypeUInt32Array> spectral_id;
+      spectral_id->SetName("spectral element id");
+      spectral_id->SetNumberOfTuples(1);
+      spectral_id->SetTuple1(0, this->myElementIndices[e]);
+      piece->GetFieldData()->AddArray(spectral_id);
+    }
+    output->SetPartition(num_pieces++, piece);
+  }
+  timer->StopTimer();
+  vtkDebugMacro(<< "updatePartitions: " << num_pieces << " structured grids in " << timer->GetElapsedTime());
+}// vtkNek5000Reader::updatePartitions()
 
+//----------------------------------------------------------------------------
+// An element is kept if the range of its values of ValueArrayName intersects
+// ValueRange, with the value ranges found when the array was read.
+bool vtkNek5000Reader::selectValueElements(std::vector<char>& keep)
+{
+  if(!this->ValueOfInterest || !this->ValueArrayName)
+    return false;
+  int v = 0;
+  while(v < this->num_vars && strcmp(this->var_names[v], this->ValueArrayName) != 0)
+    v++;
+  if(v == this->num_vars || !this->curObj->arrays[v] ||
+     this->curObj->ranges[v].size() != 2 * size_t(this->myNumBlocks))
+  {
+    vtkDebugMacro(<< "selectValueElements: " << this->ValueArrayName << " is not a scalar read, all elements are output");
+    return false;
+  }
+
+  const std::vector<float>& ranges = this->curObj->ranges[v];
+  keep.resize(this->myNumBlocks);
+  int num_kept = 0;
+  for(auto e = 0; e < this->myNumBlocks; ++e)
+  {
+    keep[e] = (ranges[2*e] <= this->ValueRange[1] && ranges[2*e+1] >= this->ValueRange[0]);
+    num_kept += keep[e];
+  }
+  vtkDebugMacro(<< "selectValueElements: " << num_kept << " of " << this->myNumBlocks << " elements have values of "
+                << this->ValueArrayName << " in [" << this->ValueRange[0] << ", " << this->ValueRange[1] << "]");
+  return true;
+}// vtkNek5000Reader::selectValueElements()
+
+// the cells 'cells' of 'offsets' and 'connectivity'
+template <class IdT, class ArrayT>
+static vtkCellArray* subsetCells(ArrayT* offsets_in, ArrayT* connectivity_in, const std::vector<vtkIdType>& cells)
+{
+  const IdT* offsets = offsets_in->GetPointer(0);
+  const IdT* connectivity = connectivity_in->GetPointer(0);
+  const vtkIdType num_cells = static_cast<vtkIdType>(cells.size());
+  vtkNew<ArrayT> new_offsets, new_connectivity;
+  new_offsets->SetNumberOfValues(num_cells + 1);
+  IdT* o = new_offsets->GetPointer(0);
+  o[0] = 0;
+  for(vtkIdType i = 0; i < num_cells; ++i)
+    o[i+1] = o[i] + (offsets[cells[i]+1] - offsets[cells[i]]);
+  new_connectivity->SetNumberOfValues(o[num_cells]);
+  IdT* c = new_connectivity->GetPointer(0);
+  vtkSMPTools::For(0, num_cells, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType i = begin; i < end; ++i)
+      std::copy(connectivity + offsets[cells[i]], connectivity + offsets[cells[i]+1], c + o[i]);
+  });
+  vtkCellArray* subset = vtkCellArray::New();
+  subset->SetData(new_offsets, new_connectivity);
+  return subset;
+}
+
+//----------------------------------------------------------------------------
+// The cells of an element follow each other, the points are left as they
+// are: the filters downstream only visit the cells.
+void vtkNek5000Reader::keepElementCells(vtkUnstructuredGrid* pv_ugrid, const std::vector<char>& keep)
+{
+  vtkCellArray* cells = pv_ugrid->GetCells();
+  vtkIdType num_cells = pv_ugrid->GetNumberOfCells();
+  if(!cells || num_cells == 0 || this->myNumBlocks == 0)
+    return;
+
+  int cell_type = pv_ugrid->GetCellType(0);
+  vtkIdType cells_per_block = num_cells / this->myNumBlocks;
+  std::vector<vtkIdType> kept;
+  for(auto e = 0; e < this->myNumBlocks; ++e)
+  {
+    if(!keep[e])
+      continue;
+    for(vtkIdType c = 0; c < cells_per_block; ++c)
+      kept.push_back(e * cells_per_block + c);
+  }
+
+  vtkCellArray* subset = cells->IsStorage64Bit() ?
+    subsetCells<vtkTypeInt64>(cells->GetOffsetsArray64(), cells->GetConnectivityArray64(), kept) :
+    subsetCells<vtkTypeInt32>(cells->GetOffsetsArray32(), cells->GetConnectivityArray32(), kept);
+
+  // the cell data of the cells kept, the spectral element ids
+  vtkCellData* cell_data = pv_ugrid->GetCellData();
+  std::vector<vtkSmartPointer<vtkDataArray>> arrays;
+  for(int i = 0; i < cell_data->GetNumberOfArrays(); ++i)
+  {
+    vtkDataArray* array = cell_data->GetArray(i);
+    if(!array)
+      continue;
+    vtkSmartPointer<vtkDataArray> gathered = vtkSmartPointer<vtkDataArray>::Take(array->NewInstance());
+    gathered->SetName(array->GetName());
+    gathered->SetNumberOfComponents(array->GetNumberOfComponents());
+    gathered->SetNumberOfTuples(static_cast<vtkIdType>(kept.size()));
+    for(size_t k = 0; k < kept.size(); ++k)
+      gathered->InsertTuple(static_cast<vtkIdType>(k), kept[k], array);
+    arrays.push_back(gathered);
+  }
+
+  pv_ugrid->SetCells(cell_type, subset);
+  subset->Delete();
+  for(vtkDataArray* array : arrays)
+    cell_data->AddArray(array);
+}// vtkNek5000Reader::keepElementCells()
+
+void vtkNek5000Reader::updateVtuData(vtkUnstructuredGrid* pv_ugrid)
+{
   int num_ranks, my_rank;
   vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
   if (ctrl != nullptr)
@@ -1356,443 +3222,888 @@ void vtkNek5000Reader::updateVtuData(vtkUnstructuredGrid* pv_ugrid)
     my_rank = 0;
   }
 
-  // if the grid in the curObj is not NULL, we may have everything we need
-  if(this->curObj->ugrid)
+  // if the grid in the curObj was made with the arrays requested, it is used as is
+  if(this->curObj->ugrid && this->objectMatchesRequest())
   {
-    vtkDebugMacro(<< "updateVtuData: my_rank= " << my_rank<<": this->curObj->ugrid != NULL, see if it matches");
-    if(this->objectMatchesRequest())
-      {
-      // copy the ugrid
-      pv_ugrid->ShallowCopy(this->curObj->ugrid);
+    vtkDebugMacro(<<"vtkNek5000Reader::updateVtuData: ugrid same, copy : Rank: "<<my_rank);
+    this->outputGrid(this->curObj->ugrid, pv_ugrid);
+    this->displayed_step = this->requested_step;
+    this->SetDataFileName(curObj->dataFilename);
+    return;
+  }
+
+  // otherwise the cells, made once (see updateCells()), and the points of the
+  // step are completed with the arrays of the step, which the cache holds
+  if(this->curObj->ugrid)
+    {
+    this->curObj->ugrid->Delete();
+    }
+  this->curObj->ugrid = vtkUnstructuredGrid::New();
+  this->curObj->ugrid->ShallowCopy(this->UGrid);
+  this->curObj->ugrid->SetPoints(this->curObj->points);
 
-      this->displayed_step = this->requested_step;
-      vtkDebugMacro(<<"vtkNek5000Reader::updateVtuData: ugrid same, copy : Rank: "<<my_rank);
-      this->SetDataFileName(curObj->dataFilename);
+  vtkDebugMacro(<< "updateVtuData: my_rank= " << my_rank<<": call copyContinuumData()");
+  this->copyContinuumData(this->curObj->ugrid);
 
-      return;
-      }
-    else if(this->objectHasExtraData())
-      {
-      for(int vid=0; vid<this->num_vars; vid++)
-        {
-        if(!this->GetPointArrayStatus(vid) && this->curObj->vars[vid])
-          {
-          // Does PV already have this array?  If so, remove it.
-          if (pv_ugrid->GetPointData()->GetArray(this->var_names[vid]) != nullptr)
-           {
-           pv_ugrid->GetPointData()->RemoveArray(this->var_names[vid]);
-           }
-         // Do I already have this array?  If so, remove it.
-         if (this->curObj->ugrid->GetPointData()->GetArray(this->var_names[vid]) != nullptr)
-           {
-           this->curObj->ugrid->GetPointData()->RemoveArray(this->var_names[vid]);
-           }
-         this->curObj->vars[vid] = false;
-         }
-       }
-
-      pv_ugrid->ShallowCopy(this->curObj->ugrid);
-      this->displayed_step = this->requested_step;
-      //if(!this->USE_MESH_ONLY)
-      {
-        this->SetDataFileName(curObj->dataFilename);
-      }
-      return;
-    } // else if(this->objectHasExtraData())
-  }// if(this->curObj->ugrid)
+  for(int kk=0; kk<this->num_vars; kk++)
+    {
+    this->curObj->vars[kk] = this->GetPointArrayStatus(kk);
+    }
 
+  this->outputGrid(this->curObj->ugrid, pv_ugrid);
+  this->displayed_step = this->requested_step;
+} // vtkNek5000Reader::updateVtuData()
 
-  // otherwise the grid in the curObj is NULL, and/or the resolution has changed,
-  // and/or we need more data than is in curObj, we need to do everything
+//----------------------------------------------------------------------------
+// Make the cells of UGrid, or use those of another reader of the process, or
+// those of the geometry cache file. They do not depend on the coordinates,
+// and are made only once.
+void vtkNek5000Reader::updateCells()
+{
+  double timer_diff;
+
+  int num_ranks, my_rank;
+  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
+  if (ctrl != nullptr)
+  {
+    num_ranks = ctrl->GetNumberOfProcesses();
+    my_rank = ctrl->GetLocalProcessId();
+  }
+  else
+  {
+    num_ranks = 1;
+    my_rank = 0;
+  }
 
   int Nvert_total = 0;
   int Nelements_total;
 
-  vtkSmartPointer<vtkPoints> points;
-    
   Nvert_total = this->myNumBlocks *  this->totalBlockSize;
-  if(this->MeshIs3D)
+  this->high_order_cells = this->useHighOrderCells();
+  if(this->HighOrderCells && !this->high_order_cells)
+  {
+    vtkWarningMacro(<< "elements of " << this->blockDims[0] << "x" << this->blockDims[1] << "x"
+                    << this->blockDims[2] << " points are split into linear cells");
+  }
+  if(this->high_order_cells)
+    Nelements_total = this->myNumBlocks;
+  else if(this->MeshIs3D)
     Nelements_total = this->myNumBlocks * (this->blockDims[0]-1) *  (this->blockDims[1]-1) *  (this->blockDims[2]-1);
   else
     Nelements_total = this->myNumBlocks * (this->blockDims[0]-1) *  (this->blockDims[1]-1);
     
-  vtkDebugMacro(<<"updateVtuData: rank = "<<my_rank<<" :Nvert_total= "<<Nvert_total<<", Nelements_total= "<<Nelements_total);
+  vtkDebugMacro(<<"updateCells: rank = "<<my_rank<<" :Nvert_total= "<<Nvert_total<<", Nelements_total= "<<Nelements_total);
 
-  // if we need to calculate the geometry (first time, or it has changed)
-  if (this->CALC_GEOM_FLAG)
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  if(this->UGrid)
     {
-    vtkNew<vtkTimerLog> timer;
-    timer->StartTimer();
-    if(this->UGrid)
-      {
-      this->UGrid->Delete();
-      }
-    this->UGrid = vtkUnstructuredGrid::New();
-    //this->UGrid->Allocate(Nelements_total);
+    this->UGrid->Delete();
+    }
+  this->UGrid = vtkUnstructuredGrid::New();
+  this->releaseMergedPoints();
+  //this->UGrid->Allocate(Nelements_total);
 // remove the Allocation here, in order to do a direct SelCells()
 // call in addCellsToContinuumMesh
-    points = vtkSmartPointer<vtkPoints>::New();
-    points->SetNumberOfPoints(Nvert_total);
-
-    std::cout << __LINE__ <<" : updateVtuData : rank = "<<my_rank<<": Nelements_total = "<<Nelements_total<<" Nvert_total = "<< Nvert_total << std::endl;
 
-    copyContinuumPoints(points);
+  vtkDebugMacro(<< "updateCells: rank = " << my_rank << ": Nelements_total = " << Nelements_total << " Nvert_total = " << Nvert_total);
 
-    timer->StopTimer();
-    timer_diff = timer->GetElapsedTime();
-    vtkDebugMacro(<< "updateVtuData: my_rank= " << my_rank<<": time to copy/convert xyz and uvw: "<< timer_diff);
-    } // if (this->CALC_GEOM_FLAG)
-
-  vtkDebugMacro(<< "updateVtuData: my_rank= " << my_rank<<": call copyContinuumData()");
-
-  this->copyContinuumData(pv_ugrid);
-
-  vtkNew<vtkTimerLog> timer;
-  timer->StartTimer();
-  if (this->CALC_GEOM_FLAG)
+  if(this->shareCells())
+    {
+    vtkDebugMacro(<< "updateCells: my_rank= " << my_rank<<": cells shared with another reader");
+    }
+  else if(!(this->GeometryCache && this->loadGeometry()))
     {
     addCellsToContinuumMesh();
-    if(this->SpectralElementIds)  // optional. If one wants to extract cells belonging to specific spectral element(s)
-      addSpectralElementId(Nelements_total);
-    this->UGrid->SetPoints(points);
     }
+  this->registerCells();
+  if(this->SpectralElementIds)  // optional. If one wants to extract cells belonging to specific spectral element(s)
+    addSpectralElementId(Nelements_total);
 
   timer->StopTimer();
   timer_diff = timer->GetElapsedTime();
-  vtkDebugMacro(<< "updateVtuData: my_rank= " << my_rank<<": time of CALC_GEOM (the mesh): "<< timer_diff);
+  vtkDebugMacro(<< "updateCells: my_rank= " << my_rank<<": time of CALC_GEOM (the mesh): "<< timer_diff);
+
+  this->CALC_GEOM_FLAG=false;
+}// vtkNek5000Reader::updateCells()
+
+//----------------------------------------------------------------------------
+// Copy the grid of a step to the output, merging its points if CleanGrid.
+void vtkNek5000Reader::outputGrid(vtkUnstructuredGrid* grid, vtkUnstructuredGrid* pv_ugrid)
+{
   if(this->CleanGrid)
     {
+    vtkNew<vtkTimerLog> timer;
     timer->StartTimer();
-    vtkNew<vtkCleanUnstructuredGrid> clean;
-
-    vtkNew<vtkUnstructuredGrid> tmpGrid;
-    tmpGrid->ShallowCopy(this->UGrid);
-    clean->SetInputData(tmpGrid.GetPointer());
-
-    clean->Update();
+    this->mergePoints(grid, pv_ugrid);
     timer->StopTimer();
-    timer_diff = timer->GetElapsedTime();
-    vtkDebugMacro(<< "updateVtuData: my_rank= " << my_rank<<": time to clean the grid: "<< timer_diff);
-
-    pv_ugrid->ShallowCopy(clean->GetOutput());
+    vtkDebugMacro(<< "outputGrid: time to clean the grid: "<< timer->GetElapsedTime());
     }
   else
     {
-    pv_ugrid->ShallowCopy(this->UGrid);
+    pv_ugrid->ShallowCopy(grid);
     }
-  vtkDebugMacro(<< "updateVtuData: my_rank= " << my_rank<<":  completed ShallowCopy to pv_ugrid\n");
-  if(this->curObj->ugrid)
-    {
-    this->curObj->ugrid->Delete();
-    }
-  this->curObj->ugrid = vtkUnstructuredGrid::New();
+}// vtkNek5000Reader::outputGrid()
 
-  this->curObj->ugrid->ShallowCopy(this->UGrid);
+//----------------------------------------------------------------------------
+// Merging the points of the elements. Only the points on the faces of an
+// element can also be points of another one: they are sorted by the cell
+// of their coordinates in a grid of a small fraction of the distance between
+// the points of an element, the tolerance, and each is merged into the first
+// point within the tolerance in its cell or the neighbouring ones, so that
+// points on either side of a cell boundary are merged too. The interior
+// points are numbered as they come.
+struct nek5KMergeKey
+{
+  int64_t q[3];
+  vtkIdType id;
 
-  this->displayed_step = this->requested_step;
-  
-  for(int kk=0; kk<this->num_vars; kk++)
+  bool operator<(const nek5KMergeKey& other) const
+  {
+    if(this->q[0] != other.q[0])
+      return this->q[0] < other.q[0];
+    if(this->q[1] != other.q[1])
+      return this->q[1] < other.q[1];
+    if(this->q[2] != other.q[2])
+      return this->q[2] < other.q[2];
+    return this->id < other.id;
+  }
+  bool sameCell(const int64_t cell[3]) const
+  {
+    return this->q[0] == cell[0] && this->q[1] == cell[1] && this->q[2] == cell[2];
+  }
+};
+
+// Give in 'ids' the merged point of each of the 'numBlocks' elements of
+// 'dims' points of 'coords', and in 'source' the point each merged point is
+// taken from.
+template <class T>
+static void mergeElementPoints(const T* coords, int numBlocks, const int* dims, bool is3D,
+                               std::vector<vtkIdType>& ids, std::vector<vtkIdType>& source)
+{
+  const int nx = dims[0], ny = dims[1], nz = is3D ? dims[2] : 1;
+  const vtkIdType blockSize = vtkIdType(nx) * ny * nz;
+  const vtkIdType numPoints = vtkIdType(numBlocks) * blockSize;
+
+  // the points of an element on its faces
+  std::vector<vtkIdType> faces;
+  for(int kk = 0; kk < nz; ++kk)
+  {
+    for(int jj = 0; jj < ny; ++jj)
     {
-    this->curObj->vars[kk] = this->GetPointArrayStatus(kk);
+      for(int ii = 0; ii < nx; ++ii)
+      {
+        if(ii == 0 || ii == nx-1 || jj == 0 || jj == ny-1 || (is3D && (kk == 0 || kk == nz-1)))
+          faces.push_back(vtkIdType(kk)*ny*nx + vtkIdType(jj)*nx + ii);
+      }
     }
+  }
 
-  this->CALC_GEOM_FLAG=false;
-} // vtkNek5000Reader::updateVtuData()
-
-void vtkNek5000Reader::addCellsToContinuumMesh()
-{
-// Note that point ids are starting at 0, and are local to each processor
-// same with cellids. Local and starting at 0 on each MPI task
-  int numVTKCells = this->myNumBlocks * (this->blockDims[0]-1) * (this->blockDims[1]-1);
-  if (this->MeshIs3D)
-    numVTKCells *= (this->blockDims[2]-1);
-    
-  vtkUnsignedCharArray* cellTypes = vtkUnsignedCharArray::New(); // type array (HEX or QUAD)
-  cellTypes->SetNumberOfTuples(numVTKCells);
-
-  vtkCellArray* outCells = vtkCellArray::New(); // the connectivity array
+  // the points of an element are the closest at its corners
+  double spacing = VTK_DOUBLE_MAX;
+  const vtkIdType neighbors[3] = { 1, nx, vtkIdType(nx) * ny };
+  for(int e = 0; e < numBlocks; ++e)
+  {
+    const T* corner = coords + e * blockSize * 3;
+    for(int n = 0; n < (is3D ? 3 : 2); ++n)
+    {
+      const T* next = corner + neighbors[n] * 3;
+      double d = std::sqrt(double(next[0]-corner[0])*(next[0]-corner[0]) + double(next[1]-corner[1])*(next[1]-corner[1]) +
+                           double(next[2]-corner[2])*(next[2]-corner[2]));
+      if(d > 0.0 && d < spacing)
+        spacing = d;
+    }
+  }
+  const double scale = (spacing < VTK_DOUBLE_MAX) ? 1000.0 / spacing : 1.0;
+  const double tolerance = 1.0 / scale;
 
-  vtkIdTypeArray* locations = vtkIdTypeArray::New(); // the offset array
-  locations->SetNumberOfTuples(numVTKCells);
-  
-  vtkIdType p, pts[8];
-  int n = 0, c=0;
-  
-  if (this->MeshIs3D)
+  const vtkIdType numFaces = static_cast<vtkIdType>(faces.size());
+  std::vector<nek5KMergeKey> keys(numBlocks * numFaces);
+  vtkSMPTools::For(0, numBlocks, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType e = begin; e < end; ++e)
     {
-    cellTypes->Fill(VTK_HEXAHEDRON);
-    outCells->Allocate(9L*numVTKCells);
-    for(auto e = 0; e < this->myNumBlocks; ++e)
+      for(vtkIdType f = 0; f < numFaces; ++f)
+      {
+        nek5KMergeKey& key = keys[e * numFaces + f];
+        key.id = e * blockSize + faces[f];
+        for(int c = 0; c < 3; ++c)
+          key.q[c] = static_cast<int64_t>(std::floor(coords[key.id * 3 + c] * scale));
+      }
+    }
+  });
+  vtkSMPTools::Sort(keys.begin(), keys.end());
+
+  // the first key before each one whose point is within the tolerance, in
+  // its cell or the 26 around it, or -1
+  std::vector<vtkIdType> match(keys.size(), -1);
+  vtkSMPTools::For(0, static_cast<vtkIdType>(keys.size()), [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType k = begin; k < end; ++k)
     {
-      for(auto ii = 0; ii < this->blockDims[0]-1; ++ii)
+      const T* point = coords + keys[k].id * 3;
+      for(int dz = -1; dz <= 1; ++dz)
       {
-        for(auto jj = 0; jj < this->blockDims[1]-1; ++jj)
+        for(int dy = -1; dy <= 1; ++dy)
         {
-          for(auto kk = 0; kk < this->blockDims[2]-1; ++kk)
+          for(int dx = -1; dx <= 1; ++dx)
           {
-            p = kk*(this->blockDims[1])*(this->blockDims[0]) + jj*(this->blockDims[0]) + ii + n;
-            pts[0] = p;
-            pts[1] = p + 1;
-            p += this->blockDims[0];
-            pts[2] = p + 1;
-            pts[3] = p;
-            p = (kk+1)*(this->blockDims[1])*(this->blockDims[0]) + jj*(this->blockDims[0]) + ii + n;
-            pts[4] = p;
-            pts[5] = p + 1;
-            p += this->blockDims[0];
-            pts[6] = p + 1;
-            pts[7] = p;
-
-            outCells->InsertNextCell(8, pts);
-            locations->SetTuple1(c, c*9L);
-            c++;
+            nek5KMergeKey cell = { { keys[k].q[0] + dx, keys[k].q[1] + dy, keys[k].q[2] + dz }, -1 };
+            vtkIdType j = static_cast<vtkIdType>(std::lower_bound(keys.begin(), keys.end(), cell) - keys.begin());
+            vtkIdType last = (match[k] >= 0) ? match[k] : k;
+            for(; j < last && keys[j].sameCell(cell.q); ++j)
+            {
+              const T* other = coords + keys[j].id * 3;
+              if(std::fabs(double(other[0]) - point[0]) <= tolerance &&
+                 std::fabs(double(other[1]) - point[1]) <= tolerance &&
+                 std::fabs(double(other[2]) - point[2]) <= tolerance)
+              {
+                match[k] = j;
+                break;
+              }
+            }
           }
         }
       }
-      n +=  this->totalBlockSize;
     }
+  });
+
+  // each point stands for itself, but the face points within the tolerance
+  // of one before, in the order of the keys
+  std::vector<vtkIdType> first(numPoints);
+  vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType i = begin; i < end; ++i)
+      first[i] = i;
+  });
+  for(size_t k = 1; k < keys.size(); ++k)
+  {
+    if(match[k] >= 0)
+      first[keys[k].id] = first[keys[match[k]].id];
+  }
+
+  // the merged points are numbered element after element
+  std::vector<vtkIdType> counts(numBlocks + 1, 0);
+  vtkSMPTools::For(0, numBlocks, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType e = begin; e < end; ++e)
+    {
+      for(vtkIdType i = e * blockSize; i < (e+1) * blockSize; ++i)
+      {
+        if(first[i] == i)
+          counts[e+1]++;
+      }
     }
-  else // 2D
+  });
+  for(int e = 0; e < numBlocks; ++e)
+    counts[e+1] += counts[e];
+
+  ids.resize(numPoints);
+  source.resize(counts[numBlocks]);
+  vtkSMPTools::For(0, numBlocks, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType e = begin; e < end; ++e)
     {
-    cellTypes->Fill(VTK_QUAD);
-    outCells->Allocate(5L*numVTKCells);
-      for(auto e = 0; e < this->myNumBlocks; ++e)
+      vtkIdType m = counts[e];
+      for(vtkIdType i = e * blockSize; i < (e+1) * blockSize; ++i)
       {
-        for(auto ii = 0; ii < this->blockDims[0]-1; ++ii)
+        if(first[i] == i)
         {
-          for(auto jj = 0; jj < this->blockDims[1]-1; ++jj)
-          {
-            p = n+jj*(this->blockDims[0]) + ii;
-            pts[0] = p;
-            pts[1] = p + 1;
-            p += this->blockDims[0];
-            pts[2] = p + 1;
-            pts[3] = p;
-            outCells->InsertNextCell(4, pts);
-            locations->SetTuple1(c, c*5L);
-            c++;
-          }
+          ids[i] = m;
+          source[m++] = i;
         }
-      n +=  this->totalBlockSize;
       }
     }
-    
-  this->UGrid->SetCells(cellTypes, locations, outCells);
-  locations->Delete();
-  outCells->Delete();
-  cellTypes->Delete();
-}// addPointsToContinuumMesh()
+  });
+  // the points merged take the number of the point they are merged into
+  vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType i = begin; i < end; ++i)
+    {
+      if(first[i] != i)
+        ids[i] = ids[first[i]];
+    }
+  });
+}
 
-void vtkNek5000Reader::addSpectralElementId(int nelements)
+// the connectivity of the cells, with the merged points
+template <class IdT>
+static void remapConnectivity(const IdT* connectivity, IdT* merged, vtkIdType size, const std::vector<vtkIdType>& ids)
 {
-  vtkTypeUInt32Array *spectral_id = vtkTypeUInt32Array::New();
-  spectral_id->SetNumberOfTuples(nelements);
-  spectral_id->SetName("spectral element id");
-  int n = 0;
-  int my_rank;
-  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
-  if (ctrl != nullptr)
+  vtkSMPTools::For(0, size, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType i = begin; i < end; ++i)
+      merged[i] = static_cast<IdT>(ids[connectivity[i]]);
+  });
+}
+
+// a new array of the tuples 'source' of 'array'
+template <class T>
+static vtkDataArray* gatherTuples(vtkDataArray* array, const std::vector<vtkIdType>& source)
+{
+  const int num_comps = array->GetNumberOfComponents();
+  const vtkIdType num_tuples = static_cast<vtkIdType>(source.size());
+  vtkAOSDataArrayTemplate<T>* gathered = newPlainArray<T>(num_comps, num_tuples);
+  T* out = gathered->GetPointer(0);
+  if(vtkNek5000BlockedArray<T>* blocked = vtkNek5000BlockedArray<T>::SafeDownCast(array))
+  {
+    vtkSMPTools::For(0, num_tuples, [&](vtkIdType begin, vtkIdType end) {
+      for(vtkIdType m = begin; m < end; ++m)
+        for(int c = 0; c < num_comps; ++c)
+          out[m * num_comps + c] = blocked->GetTypedComponent(source[m], c);
+    });
+  }
+  else
+  {
+    const T* in = static_cast<T*>(array->GetVoidPointer(0));
+    vtkSMPTools::For(0, num_tuples, [&](vtkIdType begin, vtkIdType end) {
+      for(vtkIdType m = begin; m < end; ++m)
+        for(int c = 0; c < num_comps; ++c)
+          out[m * num_comps + c] = in[source[m] * num_comps + c];
+    });
+  }
+  gathered->SetName(array->GetName());
+  return gathered;
+}
+
+//----------------------------------------------------------------------------
+// The points of the elements merged once for the cells and points of the
+// mesh, and the arrays of the step gathered with the points kept. Replaces
+// vtkCleanUnstructuredGrid, whose locator held all points.
+void vtkNek5000Reader::mergePoints(vtkUnstructuredGrid* grid, vtkUnstructuredGrid* pv_ugrid)
+{
+  vtkDataArray* coords = grid->GetPoints()->GetData();
+  if(!this->mergedCells || this->merged_points_hash != this->curObj->points_hash)
+  {
+    this->releaseMergedPoints();
+    std::vector<vtkIdType> ids;
+    if(coords->GetDataType() == VTK_DOUBLE)
+      mergeElementPoints(static_cast<double*>(coords->GetVoidPointer(0)), this->myNumBlocks,
+                         this->blockDims, this->MeshIs3D, ids, this->mergedSource);
+    else
+      mergeElementPoints(static_cast<float*>(coords->GetVoidPointer(0)), this->myNumBlocks,
+                         this->blockDims, this->MeshIs3D, ids, this->mergedSource);
+
+    vtkDataArray* merged_coords = (coords->GetDataType() == VTK_DOUBLE) ?
+      gatherTuples<double>(coords, this->mergedSource) : gatherTuples<float>(coords, this->mergedSource);
+    this->mergedPoints = vtkPoints::New();
+    this->mergedPoints->SetData(merged_coords);
+    merged_coords->Delete();
+
+    // the offsets of the cells are unchanged
+    vtkCellArray* cells = grid->GetCells();
+    this->mergedCells = vtkCellArray::New();
+    vtkIdType size = cells->GetConnectivityArray()->GetNumberOfValues();
+    if(cells->IsStorage64Bit())
     {
-    my_rank = ctrl->GetLocalProcessId();
+      vtkNew<vtkTypeInt64Array> connectivity;
+      connectivity->SetNumberOfValues(size);
+      remapConnectivity(cells->GetConnectivityArray64()->GetPointer(0), connectivity->GetPointer(0), size, ids);
+      this->mergedCells->SetData(cells->GetOffsetsArray64(), connectivity);
     }
-  else
+    else
     {
-    my_rank = 0;
+      vtkNew<vtkTypeInt32Array> connectivity;
+      connectivity->SetNumberOfValues(size);
+      remapConnectivity(cells->GetConnectivityArray32()->GetPointer(0), connectivity->GetPointer(0), size, ids);
+      this->mergedCells->SetData(cells->GetOffsetsArray32(), connectivity);
     }
+    this->merged_points_hash = this->curObj->points_hash;
+    vtkDebugMacro(<< "mergePoints: " << coords->GetNumberOfTuples() << " points merged into "
+                  << this->mergedSource.size());
+  }
 
-  int start_index=0;
-  for(auto i=0; i<my_rank; i++)
+  pv_ugrid->Initialize();
+  pv_ugrid->SetPoints(this->mergedPoints);
+  pv_ugrid->SetCells(grid->GetCellTypesArray(), this->mergedCells);
+  pv_ugrid->GetCellData()->ShallowCopy(grid->GetCellData());
+  vtkPointData* pd = grid->GetPointData();
+  for(int i = 0; i < pd->GetNumberOfArrays(); i++)
   {
-    start_index += this->proc_numBlocks[i];
+    vtkDataArray* array = pd->GetArray(i);
+    if(!array)
+      continue;
+    vtkDataArray* gathered = (array->GetDataType() == VTK_DOUBLE) ?
+      gatherTuples<double>(array, this->mergedSource) : gatherTuples<float>(array, this->mergedSource);
+    pv_ugrid->GetPointData()->AddArray(gathered);
+    gathered->Delete();
   }
-  
-  if (this->MeshIs3D)
-    {
-    for(auto e = start_index; e < start_index+this->myNumBlocks; ++e)
+}// vtkNek5000Reader::mergePoints()
+
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::releaseMergedPoints()
+{
+  if(this->mergedPoints)
+  {
+    this->mergedPoints->Delete();
+    this->mergedPoints = nullptr;
+  }
+  if(this->mergedCells)
+  {
+    this->mergedCells->Delete();
+    this->mergedCells = nullptr;
+  }
+  this->mergedSource.clear();
+  this->mergedSource.shrink_to_fit();
+}// vtkNek5000Reader::releaseMergedPoints()
+
+//----------------------------------------------------------------------------
+// Fill the offsets and connectivity of the hexahedra (or quads) splitting
+// 'numBlocks' elements of 'dims' points, element after element. 'IdT' is the
+// storage type of the cell array. The ids of the cells and points of an
+// element follow from its index, so the elements are shared among the threads.
+template <class IdT>
+static void fillContinuumCells(IdT* offsets, IdT* connectivity, int numBlocks, const int* dims, bool is3D)
+{
+  const int nx = dims[0], ny = dims[1], nz = is3D ? dims[2] : 2;
+  const IdT blockSize = IdT(nx) * ny * (is3D ? nz : 1);
+  const IdT cellsPerBlock = IdT(nx-1) * (ny-1) * (nz-1);
+  const int ptsPerCell = is3D ? 8 : 4;
+
+  vtkSMPTools::For(0, numBlocks, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType e = begin; e < end; ++e)
     {
-      for(auto ii = 0; ii < this->blockDims[0]-1; ++ii)
+      IdT n = IdT(e) * blockSize, c = IdT(e) * cellsPerBlock;
+      for(int ii = 0; ii < nx-1; ++ii)
       {
-        for(auto jj = 0; jj < this->blockDims[1]-1; ++jj)
+        for(int jj = 0; jj < ny-1; ++jj)
         {
-          for(auto kk = 0; kk < this->blockDims[2]-1; ++kk)
+          for(int kk = 0; kk < nz-1; ++kk)
           {
-            spectral_id->SetTuple1(n++, e);
+            IdT p = IdT(kk)*ny*nx + IdT(jj)*nx + ii + n;
+            IdT* pts = connectivity + c*ptsPerCell;
+            pts[0] = p;
+            pts[1] = p + 1;
+            pts[2] = p + nx + 1;
+            pts[3] = p + nx;
+            if(is3D)
+            {
+              p += IdT(ny)*nx;
+              pts[4] = p;
+              pts[5] = p + 1;
+              pts[6] = p + nx + 1;
+              pts[7] = p + nx;
+            }
+            offsets[c] = c*ptsPerCell;
+            c++;
           }
         }
       }
     }
+  });
+  offsets[IdT(numBlocks) * cellsPerBlock] = IdT(numBlocks) * cellsPerBlock * ptsPerCell;
+}
+
+//----------------------------------------------------------------------------
+// Same with one Lagrange hexahedron (or quad) per element, of all its points
+// in the node order of VTK.
+template <class IdT>
+static void fillLagrangeCells(IdT* offsets, IdT* connectivity, int numBlocks, const int* dims, bool is3D)
+{
+  const int nz = is3D ? dims[2] : 1;
+  const IdT blockSize = IdT(dims[0]) * dims[1] * nz;
+  const int order[3] = { dims[0]-1, dims[1]-1, nz-1 };
+
+  // the point of the element at each node of the cell
+  std::vector<IdT> nodes(blockSize);
+  for(int kk = 0; kk < nz; ++kk)
+  {
+    for(int jj = 0; jj < dims[1]; ++jj)
+    {
+      for(int ii = 0; ii < dims[0]; ++ii)
+      {
+        int node = is3D ? vtkHigherOrderHexahedron::PointIndexFromIJK(ii, jj, kk, order)
+                        : vtkHigherOrderQuadrilateral::PointIndexFromIJK(ii, jj, order);
+        nodes[node] = IdT(kk)*dims[1]*dims[0] + IdT(jj)*dims[0] + ii;
+      }
     }
-  else // 2D
+  }
+
+  vtkSMPTools::For(0, numBlocks, [&](vtkIdType begin, vtkIdType end) {
+    for(vtkIdType e = begin; e < end; ++e)
     {
-      for(auto e = start_index; e < start_index+this->myNumBlocks; ++e)
+      IdT n = IdT(e) * blockSize;
+      for(IdT p = 0; p < blockSize; ++p)
       {
-        for(auto ii = 0; ii < this->blockDims[0]-1; ++ii)
-        {
-          for(auto jj = 0; jj < this->blockDims[1]-1; ++jj)
-          {
-            spectral_id->SetTuple1(n++, e);
-          }
-        }
+        connectivity[n + p] = n + nodes[p];
       }
+      offsets[e] = n;
     }
+  });
+  offsets[numBlocks] = IdT(numBlocks) * blockSize;
+}
+
+void vtkNek5000Reader::addCellsToContinuumMesh()
+{
+// Note that point ids are starting at 0, and are local to each processor
+// same with cellids. Local and starting at 0 on each MPI task
+  vtkIdType numPoints = vtkIdType(this->myNumBlocks) * this->totalBlockSize;
+  vtkIdType numVTKCells, connectivitySize;
+  int cellType;
+  if(this->high_order_cells)
+  {
+    numVTKCells = this->myNumBlocks;
+    connectivitySize = numPoints;
+    cellType = this->MeshIs3D ? VTK_LAGRANGE_HEXAHEDRON : VTK_LAGRANGE_QUADRILATERAL;
+  }
+  else
+  {
+    numVTKCells = vtkIdType(this->myNumBlocks) * (this->blockDims[0]-1) * (this->blockDims[1]-1);
+    if (this->MeshIs3D)
+      numVTKCells *= (this->blockDims[2]-1);
+    connectivitySize = numVTKCells * (this->MeshIs3D ? 8 : 4);
+    cellType = this->MeshIs3D ? VTK_HEXAHEDRON : VTK_QUAD;
+  }
+
+  // the point ids are local to the rank, and fit in 32 bits but on very
+  // large partitions
+  vtkNew<vtkCellArray> outCells;
+  if(numPoints <= VTK_TYPE_INT32_MAX && connectivitySize <= VTK_TYPE_INT32_MAX)
+  {
+    vtkNew<vtkTypeInt32Array> offsets, connectivity;
+    offsets->SetNumberOfValues(numVTKCells + 1);
+    connectivity->SetNumberOfValues(connectivitySize);
+    if(this->high_order_cells)
+      fillLagrangeCells(offsets->GetPointer(0), connectivity->GetPointer(0),
+                        this->myNumBlocks, this->blockDims, this->MeshIs3D);
+    else
+      fillContinuumCells(offsets->GetPointer(0), connectivity->GetPointer(0),
+                         this->myNumBlocks, this->blockDims, this->MeshIs3D);
+    outCells->SetData(offsets, connectivity);
+  }
+  else
+  {
+    vtkNew<vtkTypeInt64Array> offsets, connectivity;
+    offsets->SetNumberOfValues(numVTKCells + 1);
+    connectivity->SetNumberOfValues(connectivitySize);
+    if(this->high_order_cells)
+      fillLagrangeCells(offsets->GetPointer(0), connectivity->GetPointer(0),
+                        this->myNumBlocks, this->blockDims, this->MeshIs3D);
+    else
+      fillContinuumCells(offsets->GetPointer(0), connectivity->GetPointer(0),
+                         this->myNumBlocks, this->blockDims, this->MeshIs3D);
+    outCells->SetData(offsets, connectivity);
+  }
+
+  this->UGrid->SetCells(cellType, outCells);
+}// addCellsToContinuumMesh()
+
+void vtkNek5000Reader::addSpectralElementId(int nelements)
+{
+  vtkTypeUInt32Array *spectral_id = vtkTypeUInt32Array::New();
+  spectral_id->SetNumberOfTuples(nelements);
+  spectral_id->SetName("spectral element id");
+  int n = 0;
+
+  // the cells of each element follow each other, one per element for Lagrange cells
+  int cells_per_block = this->myNumBlocks ? nelements / this->myNumBlocks : 0;
+  for(auto e = 0; e < this->myNumBlocks; ++e)
+  {
+    for(auto c = 0; c < cells_per_block; ++c)
+    {
+      spectral_id->SetTuple1(n++, this->myElementIndices[e]);
+    }
+  }
     this->UGrid->GetCellData()->AddArray(spectral_id);
     spectral_id->Delete();
 }// addSpectralElementId()
 
-void vtkNek5000Reader::copyContinuumPoints(vtkPoints* points)
+//----------------------------------------------------------------------------
+// The geometry cache file of this rank, next to FileName.
+std::string vtkNek5000Reader::geometryCacheName()
 {
-  int index = 0;
-  // for each element/block in the continuum mesh
-  for(auto k = 0; k < this->myNumBlocks; ++k)
+  int num_ranks = 1, my_rank = 0;
+  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
+  if (ctrl != nullptr)
   {
-    int block_offset = k * this->totalBlockSize * 3;  // 3 is for X,Y,Z coordinate components
-    // for every point in this element/block
-    for(auto i = 0; i < this->totalBlockSize; ++i)
-    {/*
-      std::cerr<< index << ": " <<
-                  this->meshCoords[block_offset+i] << ", " <<
-                  this->meshCoords[block_offset+this->totalBlockSize+i] << ", " <<
-                  this->meshCoords[block_offset+this->totalBlockSize+this->totalBlockSize+i] << std::endl;
-                  */
-    points->InsertPoint(index,
-                  this->meshCoords[block_offset+i],  // X val
-                  this->meshCoords[block_offset+this->totalBlockSize+i],  // Y val
-                  this->meshCoords[block_offset+this->totalBlockSize+this->totalBlockSize+i]); // Z val
-      index ++;
-    }
+    num_ranks = ctrl->GetNumberOfProcesses();
+    my_rank = ctrl->GetLocalProcessId();
   }
-  delete [] this->meshCoords;
-}
+  std::ostringstream name;
+  name << this->GetFileName() << "." << my_rank << "of" << num_ranks << ".geom";
+  return name.str();
+}// vtkNek5000Reader::geometryCacheName()
 
-void vtkNek5000Reader::copyContinuumData(vtkUnstructuredGrid* pv_ugrid)
+//----------------------------------------------------------------------------
+// What the geometry cache file must match to be used.
+void vtkNek5000Reader::geometryCacheKey(nek5KGeometryHeader& header)
 {
-  int num_ranks, my_rank;
+  char dfName[265];
+  int num_ranks = 1;
   vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
   if (ctrl != nullptr)
-    {
+  {
     num_ranks = ctrl->GetNumberOfProcesses();
-    my_rank = ctrl->GetLocalProcessId();
-    }
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, NEK5K_GEOMETRY_MAGIC, 8);
+  header.version = NEK5K_GEOMETRY_VERSION;
+  header.num_ranks = num_ranks;
+  header.partition_hash = hashBytes(this->blockDims, sizeof(this->blockDims));
+  header.partition_hash = hashBytes(&this->numBlocks, sizeof(this->numBlocks), header.partition_hash);
+  header.partition_hash = hashBytes(this->myBlockPositions, sizeof(int) * this->myNumBlocks, header.partition_hash);
+  header.partition_hash = hashBytes(&this->element_stride, sizeof(this->element_stride), header.partition_hash);
+  header.partition_hash = hashBytes(&this->projection_order, sizeof(this->projection_order), header.partition_hash);
+  if(this->high_order_cells)
+    header.cell_type = this->MeshIs3D ? VTK_LAGRANGE_HEXAHEDRON : VTK_LAGRANGE_QUADRILATERAL;
   else
-    {
-    num_ranks = 1;
-    my_rank = 0;
-    }
+    header.cell_type = this->MeshIs3D ? VTK_HEXAHEDRON : VTK_QUAD;
+  sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start);
+  fileStamp(dfName, header.mesh_mtime, header.mesh_size);
+  std::string map_filename = partitionMapName(this->GetFileName());
+  if(!fileStamp(map_filename.c_str(), header.map_mtime, header.map_size))
+    header.map_mtime = header.map_size = 0;
+}// vtkNek5000Reader::geometryCacheKey()
 
-  int index = 0;
-  int cur_scalar_index=0;
-  int cur_vector_index=0;
-  int num_verts = this->myNumBlocks * this->totalBlockSize;
+//----------------------------------------------------------------------------
+// Use the cells of the geometry cache file, mapped in memory, for UGrid, and
+// keep its points in geometryPoints for the steps of the first mesh. Returns
+// false if the file is missing or out of date. Called by updateCells().
+bool vtkNek5000Reader::loadGeometry()
+{
+  std::string name = this->geometryCacheName();
+  std::shared_ptr<nek5KMapping> mapping = nek5KMapping::create(name.c_str());
+  if(!mapping || mapping->size < sizeof(nek5KGeometryHeader))
+    return false;
+
+  nek5KGeometryHeader key, header;
+  this->geometryCacheKey(key);
+  memcpy(&header, mapping->data, sizeof(header));
+  int64_t num_points = int64_t(this->myNumBlocks) * this->totalBlockSize;
+  int id_size = header.ids_64bit ? 8 : 4;
+  int points_size = (header.points_type == VTK_DOUBLE) ? 8 : 4;
+  int64_t points_offset = alignedSize(sizeof(header));
+  int64_t offsets_offset = points_offset + alignedSize(header.num_points * 3 * points_size);
+  int64_t connectivity_offset = offsets_offset + alignedSize((header.num_cells + 1) * id_size);
+  int64_t types_offset = connectivity_offset + alignedSize(header.connectivity_size * id_size);
+  if(memcmp(header.magic, key.magic, 8) != 0 || header.version != key.version ||
+     header.num_ranks != key.num_ranks || header.partition_hash != key.partition_hash ||
+     header.mesh_mtime != key.mesh_mtime || header.mesh_size != key.mesh_size ||
+     header.map_mtime != key.map_mtime || header.map_size != key.map_size || header.cell_type != key.cell_type ||
+     header.num_points != num_points || int64_t(mapping->size) < types_offset + header.num_cells)
+  {
+    vtkDebugMacro(<< "loadGeometry: " << name << " is out of date");
+    return false;
+  }
 
-  vtkFloatArray** scalars;
-  scalars = (vtkFloatArray**) malloc(this->num_used_scalars * sizeof(vtkFloatArray*));
+  vtkNew<vtkCellArray> cells;
+  if(header.ids_64bit)
+  {
+    vtkNew<vtkTypeInt64Array> offsets, connectivity;
+    offsets->SetArray((vtkTypeInt64*)nek5KMapping::share(mapping, offsets_offset), header.num_cells + 1, 0,
+                      vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+    offsets->SetArrayFreeFunction(nek5KMapping::release);
+    connectivity->SetArray((vtkTypeInt64*)nek5KMapping::share(mapping, connectivity_offset), header.connectivity_size, 0,
+                           vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+    connectivity->SetArrayFreeFunction(nek5KMapping::release);
+    cells->SetData(offsets, connectivity);
+  }
+  else
+  {
+    vtkNew<vtkTypeInt32Array> offsets, connectivity;
+    offsets->SetArray((vtkTypeInt32*)nek5KMapping::share(mapping, offsets_offset), header.num_cells + 1, 0,
+                      vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+    offsets->SetArrayFreeFunction(nek5KMapping::release);
+    connectivity->SetArray((vtkTypeInt32*)nek5KMapping::share(mapping, connectivity_offset), header.connectivity_size, 0,
+                           vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+    connectivity->SetArrayFreeFunction(nek5KMapping::release);
+    cells->SetData(offsets, connectivity);
+  }
+  vtkNew<vtkUnsignedCharArray> types;
+  types->SetArray((unsigned char*)nek5KMapping::share(mapping, types_offset), header.num_cells, 0,
+                  vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+  types->SetArrayFreeFunction(nek5KMapping::release);
+  this->UGrid->SetCells(types, cells);
+
+  // points of another precision are read again
+  if(this->geometryPoints)
+  {
+    this->geometryPoints->Delete();
+    this->geometryPoints = nullptr;
+  }
+  if(header.points_type == this->dataType)
+  {
+    vtkDataArray* coords = nek5KMapping::wrap(mapping, header.points_type, points_offset, num_points * 3);
+    coords->SetNumberOfComponents(3);
+    this->geometryPoints = vtkPoints::New();
+    this->geometryPoints->SetData(coords);
+    coords->Delete();
+    this->geometry_saved = true;
+  }
+  vtkDebugMacro(<< "loadGeometry: mapped " << header.num_cells << " cells"
+                << (this->geometryPoints ? " and their points" : "") << " from " << name);
+  return true;
+}// vtkNek5000Reader::loadGeometry()
+
+//----------------------------------------------------------------------------
+// Write the cells of UGrid, and 'points', those of the first mesh, to the
+// geometry cache file. Nothing is written in read-only directories.
+void vtkNek5000Reader::saveGeometry(vtkPoints* points)
+{
+  vtkCellArray* cells = this->UGrid->GetCells();
+  vtkUnsignedCharArray* types = this->UGrid->GetCellTypesArray();
+  if(!cells || !types || !points)
+    return;
+
+  nek5KGeometryHeader header;
+  this->geometryCacheKey(header);
+  header.points_type = points->GetData()->GetDataType();
+  header.ids_64bit = cells->IsStorage64Bit() ? 1 : 0;
+  header.num_points = points->GetNumberOfPoints();
+  header.num_cells = cells->GetNumberOfCells();
+  vtkDataArray* offsets = cells->GetOffsetsArray();
+  vtkDataArray* connectivity = cells->GetConnectivityArray();
+  header.connectivity_size = connectivity->GetNumberOfValues();
+
+  std::string name = this->geometryCacheName();
+  // written aside, then renamed, so that it is never seen half written
+  std::string tmpName = name + ".tmp";
+  std::ofstream out(tmpName.c_str(), std::ofstream::binary);
+  if(!out.is_open())
+    return;
+
+  const char padding[8] = { 0 };
+  auto writeSection = [&](const void* data, int64_t size) {
+    out.write((const char*)data, size);
+    out.write(padding, alignedSize(size) - size);
+  };
+  writeSection(&header, sizeof(header));
+  writeSection(points->GetData()->GetVoidPointer(0), header.num_points * 3 * points->GetData()->GetDataTypeSize());
+  writeSection(offsets->GetVoidPointer(0), offsets->GetNumberOfValues() * offsets->GetDataTypeSize());
+  writeSection(connectivity->GetVoidPointer(0), header.connectivity_size * connectivity->GetDataTypeSize());
+  writeSection(types->GetVoidPointer(0), header.num_cells);
+  out.close();
+  if(!out || std::rename(tmpName.c_str(), name.c_str()) != 0)
+  {
+    std::remove(tmpName.c_str());
+    return;
+  }
+  vtkDebugMacro(<< "saveGeometry: wrote " << name);
+}// vtkNek5000Reader::saveGeometry()
 
-  vtkFloatArray** vectors;
-  vectors = (vtkFloatArray**) malloc(this->num_used_vectors * sizeof(vtkFloatArray*));
+//----------------------------------------------------------------------------
+// The key of my cells among those shared by the readers of the process.
+std::string vtkNek5000Reader::cellsKey()
+{
+  std::ostringstream key;
+  key << this->myNumBlocks << ":" << this->blockDims[0] << "x" << this->blockDims[1] << "x" << this->blockDims[2]
+      << (this->high_order_cells ? ":lagrange" : ":linear");
+  return key.str();
+}// vtkNek5000Reader::cellsKey()
+
+//----------------------------------------------------------------------------
+// Use the cells another reader of the process made for the same elements.
+bool vtkNek5000Reader::shareCells()
+{
+  std::lock_guard<std::mutex> lock(sharedGeometryMutex());
+  auto found = sharedCells().find(this->cellsKey());
+  if(found == sharedCells().end() || !found->second.cells || !found->second.types)
+    return false;
+  this->UGrid->SetCells(found->second.types, found->second.cells);
+  return true;
+}// vtkNek5000Reader::shareCells()
+
+//----------------------------------------------------------------------------
+// Offer the cells of UGrid to the other readers of the process.
+void vtkNek5000Reader::registerCells()
+{
+  std::lock_guard<std::mutex> lock(sharedGeometryMutex());
+  nek5KSharedCells& shared = sharedCells()[this->cellsKey()];
+  shared.cells = this->UGrid->GetCells();
+  shared.types = this->UGrid->GetCellTypesArray();
+}// vtkNek5000Reader::registerCells()
+
+//----------------------------------------------------------------------------
+// The data file of 'mesh_step', with what else makes its points those of this
+// reader, to find them among the points shared by the readers of the process.
+std::string vtkNek5000Reader::pointsSource(int mesh_step)
+{
+  char dfName[265];
+  sprintf(dfName, this->datafile_format.c_str(), 0, this->datafile_start + mesh_step);
+  std::string path = vtksys::SystemTools::CollapseFullPath(dfName);
+  nek5KGeometryHeader key;
+  this->geometryCacheKey(key);
+  std::ostringstream source;
+  int64_t mtime = 0, size = 0;
+  fileStamp(path.c_str(), mtime, size);
+  source << path << ":" << mtime << ":" << size << ":" << key.partition_hash << ":" << this->dataType;
+  return source.str();
+}// vtkNek5000Reader::pointsSource()
 
-  // allocate arrays for used scalars and vectors
-  for(auto jj=0; jj < this->num_vars; jj++)
+//----------------------------------------------------------------------------
+// Points shared by the readers of the process, read from 'source' or with the
+// values of 'points' (then of hash 'hash'), or nullptr. The caller gets a reference.
+vtkPoints* vtkNek5000Reader::findSharedPoints(const std::string& source, vtkPoints* points, size_t hash)
+{
+  std::lock_guard<std::mutex> lock(sharedGeometryMutex());
+  std::list<nek5KSharedPoints>& shared = sharedPoints();
+  shared.remove_if([](const nek5KSharedPoints& entry) { return !entry.points; });
+  for(nek5KSharedPoints& entry : shared)
   {
-    if(this->GetPointArrayStatus(jj) == 1)
+    if(entry.points == points)
+      continue;
+    if(points ? (entry.hash == hash && samePoints(entry.points->GetData(), points->GetData()))
+              : entry.source == source)
     {
-      // if this variable is a scalar
-      if(this->var_length[jj] == 1)
-      {
-        vtkDebugMacro(<< "copyContinuumData: my_rank= " << my_rank<<": var["<<jj<<"]: allocate scalars["<<cur_scalar_index<<"]:  name= "<< this->var_names[jj]);
-        scalars[cur_scalar_index] = vtkFloatArray::New();
-        scalars[cur_scalar_index]->SetNumberOfComponents(1);
-        scalars[cur_scalar_index]->SetNumberOfValues(num_verts);
-        scalars[cur_scalar_index]->SetName(this->var_names[jj]);
-        cur_scalar_index++;
-      }
-      // if this variable is a vector
-      else if(this->var_length[jj] > 1)
-      {
-        vtkDebugMacro(<< "copyContinuumData: my_rank= " << my_rank<<": var["<<jj<<"]: allocate vectors["<<cur_vector_index<<"]:  name= "<< this->var_names[jj]);
-        vectors[cur_vector_index] = vtkFloatArray::New();
-        vectors[cur_vector_index]->SetNumberOfComponents(3);
-        vectors[cur_vector_index]->SetNumberOfTuples(num_verts);
-        vectors[cur_vector_index]->SetName(this->var_names[jj]);
-        cur_vector_index++;
-      }
+      entry.points->Register(nullptr);
+      return entry.points;
     }
   }
+  return nullptr;
+}// vtkNek5000Reader::findSharedPoints()
 
-  cur_scalar_index=0;
-  cur_vector_index=0;
-
-  // for each variable
-  for(auto v_index=0; v_index < this->num_vars; v_index++)
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::registerPoints(const std::string& source, vtkPoints* points, size_t hash)
+{
+  std::lock_guard<std::mutex> lock(sharedGeometryMutex());
+  for(nek5KSharedPoints& entry : sharedPoints())
   {
-    if(this->use_variable[v_index])
-    {
-      // if this is a scalar
-      if(this->var_length[v_index] == 1)
-      {
-        index=0;
-        // for each  element/block in the continuum mesh
-        for(int b_index = 0; b_index < this->myNumBlocks; ++b_index)
-        {
-          // for every point in this element/block
-          for(int p_index = 0; p_index < this->totalBlockSize; ++p_index)
-          {
-             scalars[cur_scalar_index]->SetValue(index, this->dataArray[v_index][index]);
-             index++;
-          }
-        }
-    
-        this->UGrid->GetPointData()->AddArray(scalars[cur_scalar_index]);
-        scalars[cur_scalar_index]->Delete();
-        cur_scalar_index++;
-      }
-      // if this is a vector
-      else if(this->var_length[v_index] > 1)
-      {
-        index=0;
-        // for each  element/block in the continuum mesh
-        for(int b_index = 0; b_index < this->myNumBlocks; ++b_index)
-        {
-          // for every point in this element/block
-          // cerr<<"rank= "<<my_rank<<" : b_index= "<< b_index<<endl;
-          int mag_block_offset = b_index*this->totalBlockSize;
-          int comp_block_offset = mag_block_offset * 3;
+    if(entry.points == points)
+      return;
+  }
+  nek5KSharedPoints entry;
+  entry.source = source;
+  entry.hash = hash;
+  entry.points = points;
+  sharedPoints().push_back(entry);
+}// vtkNek5000Reader::registerPoints()
 
-          for(int p_index = 0; p_index < this->totalBlockSize; ++p_index)
-          {
-            float vx, vy, vz;
-            vx = this->dataArray[v_index][comp_block_offset + p_index];
-            vy = this->dataArray[v_index][comp_block_offset + p_index + this->totalBlockSize];
-            vz = this->dataArray[v_index][comp_block_offset + p_index + this->totalBlockSize + this->totalBlockSize];
-            vectors[cur_vector_index]->SetTuple3(index, vx, vy, vz);
-            index++;
-          }
-        }
+void vtkNek5000Reader::copyContinuumPoints(vtkPoints* points)
+{
+  // make tuples of the X, Y and Z blocks of each element/block, and use them as the points
+  if(this->dataType == VTK_DOUBLE)
+    interleaveBlocks(static_cast<double*>(this->meshCoords->GetVoidPointer(0)),
+                     this->myNumBlocks, this->totalBlockSize, 3);
+  else
+    interleaveBlocks(static_cast<float*>(this->meshCoords->GetVoidPointer(0)),
+                     this->myNumBlocks, this->totalBlockSize, 3);
+  points->SetData(this->meshCoords);
+  this->meshCoords->Delete();
+  this->meshCoords = nullptr;
+}
 
-        this->UGrid->GetPointData()->AddArray(vectors[cur_vector_index]);
-        vectors[cur_vector_index]->Delete();
-        cur_vector_index++;
-      }
-    }// if(this->use_variable[v_index])
-    else
+void vtkNek5000Reader::copyContinuumData(vtkUnstructuredGrid* pv_ugrid)
+{
+  int num_ranks, my_rank;
+  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
+  if (ctrl != nullptr)
+    {
+    num_ranks = ctrl->GetNumberOfProcesses();
+    my_rank = ctrl->GetLocalProcessId();
+    }
+  else
     {
-      // remove array if present, it is not needed
-      if (pv_ugrid->GetPointData()->GetArray(this->var_names[v_index]) != NULL)
-      {
-        pv_ugrid->GetPointData()->RemoveArray(this->var_names[v_index]);
-      }
-      // Do I already have this array?  If so, remove it.
-      if (this->UGrid->GetPointData()->GetArray(this->var_names[v_index]) != NULL)
-      {
-        this->UGrid->GetPointData()->RemoveArray(this->var_names[v_index]);
-      }
+    num_ranks = 1;
+    my_rank = 0;
     }
-  }
 
-  free(scalars);
-  free(vectors);
+  // the grid gets the arrays selected, and only them
+  pv_ugrid->GetPointData()->Initialize();
+  for(auto v_index=0; v_index < this->num_vars; v_index++)
+  {
+    if(this->use_variable[v_index])
+    {
+      // the data was read in place and is held by the cache, the grid only takes a reference to it
+      vtkDebugMacro(<< "copyContinuumData: my_rank= " << my_rank<<": var["<<v_index<<"]: add array "<< this->var_names[v_index]);
+      pv_ugrid->GetPointData()->AddArray(this->curObj->arrays[v_index]);
+    }// if(this->use_variable[v_index])
+  }
 } // vtkNek5000Reader::copyContinuumData()
 
-// see if the current object is missing data that was requested
+// see if the current object is missing arrays that were requested
 // return true if it is, otherwise false
 bool vtkNek5000Reader::isObjectMissingData()
 {
@@ -1812,7 +4123,7 @@ bool vtkNek5000Reader::isObjectMissingData()
 // check the stored variables
   for(int i=0; i<this->num_vars; i++)
   {
-    if(this->GetPointArrayStatus(i) ==1 && !this->curObj->vars[i])
+    if(this->GetPointArrayStatus(i) ==1 && !this->curObj->arrays[i])
     {
       return(true);
     }
@@ -1849,47 +4160,264 @@ bool vtkNek5000Reader::objectMatchesRequest()
 }// vtkNek5000Reader::objectMatchesRequest()
 
 
-bool vtkNek5000Reader::objectHasExtraData()
+int vtkNek5000Reader::CanReadFile(const char* fname)
 {
-// see if the current object has extra data than was requested
-// return false if object has less than request, otherwise true
-    
-  int num_ranks, my_rank;
-  vtkMultiProcessController* ctrl = vtkMultiProcessController::GetGlobalController();
-  if (ctrl != nullptr)
+  FILE* fp;
+  if ((fp = vtksys::SystemTools::Fopen(fname, "r")) == nullptr)
   {
-    num_ranks = ctrl->GetNumberOfProcesses();
-    my_rank = ctrl->GetLocalProcessId();
+    return 0;
   }
   else
+    return 1;
+}// vtkNek5000Reader::CanReadFile()
+
+//----------------------------------------------------------------------------
+bool vtkNek5000Reader::isStepInList(int step)
+{
+  nek5KObject* obj = this->myCache->findObject(step);
+  if(!obj)
+    return false;
+  for(int i=0; i<this->num_vars; i++)
   {
-    num_ranks = 1;
-    my_rank = 0;
+    if(this->use_variable[i] && !obj->arrays[i])
+      return false;
   }
+  return true;
+}// vtkNek5000Reader::isStepInList()
 
-// check the stored variables, if it was requested, but it is not in the current object, return false
-  for(int i=0; i<this->num_vars; i++)
+//----------------------------------------------------------------------------
+vtkIdType vtkNek5000Reader::GetCacheResidentBytes()
+{
+  return this->myCache->residentBytes();
+}// vtkNek5000Reader::GetCacheResidentBytes()
+
+//----------------------------------------------------------------------------
+int vtkNek5000Reader::GetNumberOfCachedSteps()
+{
+  return this->myCache->size();
+}// vtkNek5000Reader::GetNumberOfCachedSteps()
+
+//----------------------------------------------------------------------------
+// Bytes of the arrays and points of the cached steps, of the steps read ahead,
+// and of the cells. 'output' is counted if it does not share them (CleanGrid).
+vtkIdType vtkNek5000Reader::residentBytes(vtkUnstructuredGrid* output)
+{
+  vtkIdType bytes = this->myCache->residentBytes();
+  if(this->UGrid)
+    bytes += static_cast<vtkIdType>(this->UGrid->GetActualMemorySize()) * 1024;
   {
-    if(this->GetPointArrayStatus(i) && !this->curObj->vars[i])
+    std::lock_guard<std::mutex> lock(this->prefetchMutex);
+    for(const nek5KPrefetchedStep& prefetched : this->prefetchedSteps)
     {
-      return(false);
+      for(vtkDataArray* array : prefetched.arrays)
+      {
+        if(array)
+          bytes += static_cast<vtkIdType>(array->GetActualMemorySize()) * 1024;
+      }
     }
- }
-   
-  vtkDebugMacro(<< "objectHasExtraData(): my_rank= " << my_rank<<" : returning true");
-  return(true);    
-}// vtkNek5000Reader::objectHasExtraData()
+  }
+  if(output && this->CleanGrid)
+    bytes += static_cast<vtkIdType>(output->GetActualMemorySize()) * 1024;
+  return bytes;
+}// vtkNek5000Reader::residentBytes()
 
-int vtkNek5000Reader::CanReadFile(const char* fname)
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::updatePeakMemory(vtkUnstructuredGrid* output)
 {
-  FILE* fp;
-  if ((fp = vtksys::SystemTools::Fopen(fname, "r")) == nullptr)
+  // the arrays of the step shown are not counted by the cache yet
+  this->myCache->update(this->curObj, VTK_ID_MAX);
+  this->PeakMemoryBytes = std::max(this->PeakMemoryBytes, this->residentBytes(output));
+}// vtkNek5000Reader::updatePeakMemory()
+
+//----------------------------------------------------------------------------
+// Queue the PrefetchDepth steps following the one just shown, in the direction
+// of the animation, for prefetchThread. Steps read ahead which are no longer
+// wanted are dropped.
+void vtkNek5000Reader::schedulePrefetch()
+{
+  // the ranks would not all read the same steps at the same time
+  if(this->PrefetchDepth <= 0 || this->useCollectiveIO() || this->LowMemory)
   {
-    return 0;
+    this->discardPrefetchedSteps();
+    this->previous_step = this->requested_step;
+    return;
   }
-  else
-    return 1;
-}// vtkNek5000Reader::CanReadFile()
+
+  int direction = this->PrefetchDirection;
+  if(direction == 0)
+    direction = (this->previous_step > this->requested_step) ? -1 : 1;
+  this->previous_step = this->requested_step;
+
+  std::vector<int> steps;
+  for(int k=1; k<=this->PrefetchDepth; k++)
+  {
+    int index = this->ActualTimeStep + k * direction;
+    if(index < this->TimeStepRange[0] || index > this->TimeStepRange[1])
+      break;
+    steps.push_back(this->datafile_start + index);
+  }
+  std::vector<bool> vars(this->use_variable, this->use_variable + this->num_vars);
+  // whether their files include the mesh, found by all ranks together
+  for(int step : steps)
+    this->meshStepOf(step - this->datafile_start);
+
+  std::lock_guard<std::mutex> lock(this->prefetchMutex);
+  // the step being read, if any, is dropped on a later call, once read
+  for(auto it = this->prefetchedSteps.begin(); it != this->prefetchedSteps.end(); )
+  {
+    bool reading = it->started && !it->ready;
+    if(!reading && (std::find(steps.begin(), steps.end(), it->step) == steps.end() || it->failed ||
+                    it->vars != vars || !this->isPrefetchMatching(*it)))
+    {
+      for(vtkDataArray* array : it->arrays)
+      {
+        if(array)
+          array->Delete();
+      }
+      it = this->prefetchedSteps.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  for(int step : steps)
+  {
+    bool queued = false;
+    for(const nek5KPrefetchedStep& prefetched : this->prefetchedSteps)
+    {
+      queued = queued || prefetched.step == step;
+    }
+    if(!queued && !this->isStepInList(step))
+    {
+      nek5KPrefetchedStep prefetched;
+      prefetched.step = step;
+      prefetched.vars = vars;
+      prefetched.settings = this->readSettings();
+      prefetched.settings.hasMesh = this->timestep_has_mesh[step - this->datafile_start];
+      this->prefetchedSteps.push_back(std::move(prefetched));
+    }
+  }
+
+  if(!this->prefetchThread.joinable())
+  {
+    this->prefetchQuit = false;
+    this->prefetchThread = std::thread(&vtkNek5000Reader::prefetchLoop, this);
+  }
+  this->prefetchCondition.notify_all();
+}// vtkNek5000Reader::schedulePrefetch()
+
+//----------------------------------------------------------------------------
+// See if a step read ahead has the type and layout of the arrays now asked for.
+bool vtkNek5000Reader::isPrefetchMatching(const nek5KPrefetchedStep& prefetched)
+{
+  return prefetched.settings.dataType == this->dataType &&
+         prefetched.settings.blockedVectors == this->BlockedVectors;
+}// vtkNek5000Reader::isPrefetchMatching()
+
+//----------------------------------------------------------------------------
+// Make prefetchThread idle, so that the layout of the files and the
+// partition it reads with can be changed.
+void vtkNek5000Reader::waitForPrefetch()
+{
+  std::unique_lock<std::mutex> lock(this->prefetchMutex);
+  this->prefetchedSteps.remove_if([](const nek5KPrefetchedStep& prefetched) { return !prefetched.started; });
+  this->prefetchCondition.wait(lock, [this]() {
+    for(const nek5KPrefetchedStep& prefetched : this->prefetchedSteps)
+    {
+      if(!prefetched.ready)
+        return false;
+    }
+    return true;
+  });
+}// vtkNek5000Reader::waitForPrefetch()
+
+//----------------------------------------------------------------------------
+// If the requested step was read ahead with the variables missing from the
+// cache and the options now requested, make its arrays the ones just read.
+// If the prefetch thread is reading it, it is waited for.
+bool vtkNek5000Reader::takePrefetchedStep()
+{
+  if((this->PrefetchDepth <= 0 || this->useCollectiveIO() || this->LowMemory) && this->prefetchedSteps.empty())
+    return false;
+
+  std::unique_lock<std::mutex> lock(this->prefetchMutex);
+  for(auto it = this->prefetchedSteps.begin(); it != this->prefetchedSteps.end(); ++it)
+  {
+    if(it->step != this->requested_step || !this->isPrefetchMatching(*it))
+      continue;
+    if(!it->started)
+    {
+      // read now instead
+      this->prefetchedSteps.erase(it);
+      break;
+    }
+    this->prefetchCondition.wait(lock, [&it]() { return it->ready; });
+    if(it->failed)
+      continue;
+    bool complete = true;
+    for(int i=0; i<this->num_vars; i++)
+    {
+      complete = complete && (!this->use_variable[i] || this->curObj->arrays[i] || it->arrays[i]);
+    }
+    if(!complete)
+      continue;
+
+    this->releaseDataArrays();
+    this->dataArray.swap(it->arrays);
+    this->dataRanges.swap(it->ranges);
+    this->addReadStats(it->stats);
+    this->prefetchedSteps.erase(it);
+    this->NumberOfPrefetchHits++;
+    return true;
+  }
+  this->NumberOfPrefetchMisses++;
+  return false;
+}// vtkNek5000Reader::takePrefetchedStep()
+
+//----------------------------------------------------------------------------
+void vtkNek5000Reader::discardPrefetchedSteps()
+{
+  this->waitForPrefetch();
+  std::lock_guard<std::mutex> lock(this->prefetchMutex);
+  for(nek5KPrefetchedStep& prefetched : this->prefetchedSteps)
+  {
+    for(vtkDataArray* array : prefetched.arrays)
+    {
+      if(array)
+        array->Delete();
+    }
+  }
+  this->prefetchedSteps.clear();
+}
+
+//----------------------------------------------------------------------------
+// Body of prefetchThread: read the queued steps one after the other.
+void vtkNek5000Reader::prefetchLoop()
+{
+  std::unique_lock<std::mutex> lock(this->prefetchMutex);
+  while(!this->prefetchQuit)
+  {
+    auto next = std::find_if(this->prefetchedSteps.begin(), this->prefetchedSteps.end(),
+                             [](const nek5KPrefetchedStep& prefetched) { return !prefetched.started; });
+    if(next == this->prefetchedSteps.end())
+    {
+      this->prefetchCondition.wait(lock);
+      continue;
+    }
+    next->started = true;
+    lock.unlock();
+
+    char dfName[256];
+    sprintf(dfName, this->datafile_format.c_str(), 0, next->step);
+    bool ok = this->readStep(dfName, next->settings, next->vars, next->arrays, next->ranges, next->stats, false);
+
+    lock.lock();
+    next->failed = !ok;
+    next->ready = true;
+    this->prefetchCondition.notify_all();
+  }
+}// vtkNek5000Reader::prefetchLoop()
 
 nek5KObject::nek5KObject()
 {
@@ -1900,11 +4428,15 @@ nek5KObject::nek5KObject()
   for(int ii=0; ii<MAX_VARS; ii++)
   {
     this->vars[ii] = false;
+    this->arrays[ii] = nullptr;
   }
 
   this->index = 0;
-  this->prev = nullptr;
-  this->next = nullptr;
+  this->bytes = 0;
+  this->points = nullptr;
+  this->points_hash = 0;
+  this->owns_points = false;
+  this->mesh_step = -1;
   this->dataFilename = nullptr;
 }
 
@@ -1912,6 +4444,13 @@ nek5KObject::~nek5KObject()
 {
   if(this->ugrid)
     this->ugrid->Delete();
+  if(this->points)
+    this->points->Delete();
+  for(int ii=0; ii<MAX_VARS; ii++)
+  {
+    if(this->arrays[ii])
+      this->arrays[ii]->Delete();
+  }
   if(this->dataFilename)
   {
     free(this->dataFilename);
@@ -1924,23 +4463,43 @@ void nek5KObject::reset()
   this->vorticity = false;
   this->lambda_2 = false;
 
+  this->releaseData();
+  this->index = 0;
+  this->bytes = 0;
+
+  if(this->dataFilename)
+  {
+    free(this->dataFilename);
+    this->dataFilename = nullptr;
+  }
+}
+
+// the cache recounts the bytes of the object in nek5KCache::update()
+void nek5KObject::releaseData()
+{
   for(int ii=0; ii<MAX_VARS; ii++)
   {
     this->vars[ii] = false;
+    if(this->arrays[ii])
+    {
+      this->arrays[ii]->Delete();
+      this->arrays[ii] = nullptr;
+    }
+    this->ranges[ii].clear();
   }
-  this->index = 0;
 
   if(this->ugrid)
   {
     this->ugrid->Delete();
     this->ugrid = nullptr;
   }
-
-  if(this->dataFilename)
+  if(this->points)
   {
-    free(this->dataFilename);
-    this->dataFilename = nullptr;
+    this->points->Delete();
+    this->points = nullptr;
   }
+  this->owns_points = false;
+  this->mesh_step = -1;
 }
 
 void nek5KObject::setDataFilename(char* filename)
@@ -1952,136 +4511,336 @@ void nek5KObject::setDataFilename(char* filename)
   this->dataFilename = strdup(filename);
 }
 
-nek5KList::nek5KList()
+nek5KObject* nek5KCache::getObject(int id)
+{
+  auto found = this->index.find(id);
+  if(found != this->index.end())
+  {
+    // move it last, as the most recently used
+    this->objects.splice(this->objects.end(), this->objects, found->second);
+    return &*found->second;
+  }
+  this->objects.emplace_back();
+  auto obj = std::prev(this->objects.end());
+  obj->index = id;
+  this->index[id] = obj;
+  return &*obj;
+}
+
+nek5KObject* nek5KCache::findObject(int id)
 {
-  this->head = nullptr;
-  this->tail = nullptr;
-  this->max_count = 10;
-  this->cur_count = 0;
+  auto found = this->index.find(id);
+  return found == this->index.end() ? nullptr : &*found->second;
 }
 
-nek5KList::~nek5KList()
+void nek5KCache::update(nek5KObject* obj, vtkIdType budget)
 {
-  int new_cnt = 0;
-  nek5KObject* curObj = this->head;
-  while (curObj && new_cnt<this->cur_count)
+  obj->bytes = 0;
+  for(int i=0; i<MAX_VARS; i++)
+  {
+    // GetActualMemorySize() is in KiB
+    if(obj->arrays[i])
+      obj->bytes += static_cast<vtkIdType>(obj->arrays[i]->GetActualMemorySize()) * 1024;
+    obj->bytes += static_cast<vtkIdType>(obj->ranges[i].size() * sizeof(float));
+  }
+  this->resident = this->countBytes();
+
+  while(this->resident > budget && this->objects.size() > 1 && &this->objects.front() != obj)
   {
-    this->head = this->head->next;
-    delete curObj;
-    curObj = this->head;
-    new_cnt++;
+    this->index.erase(this->objects.front().index);
+    this->objects.pop_front();
+    // the points of the step dropped are freed only if no other step holds them
+    this->resident = this->countBytes();
   }
 }
 
-nek5KObject* nek5KList::getObject(int id)
+vtkIdType nek5KCache::countBytes() const
 {
-    nek5KObject* curObj = this->head;
-    while (curObj)
-      {
-      if (curObj->index == id)  // if we found it
-        {
-        // move found obj to tail of the list
-        // if already tail, do nothing
-        if(curObj == this->tail)
-        break;
-    
-        // if it's the head, update head to next
-        if(curObj == this->head)
-          {
-          this->head = this->head->next;
-          }
-        // now move curObj to tail
-        curObj->next->prev = curObj->prev;
-        if(curObj->prev) // i.e. if current was not the head
-          {
-          curObj->prev->next = curObj->next;
-          }
-        this->tail->next = curObj;
-        curObj->prev = this->tail;
-        curObj->next = nullptr;
-        this->tail = curObj;
-        break;
-        }
-      else // otherwise, lok at the next one
-        {
-        curObj = curObj->next;
-        }
-      }
+  vtkIdType bytes = 0;
+  std::set<vtkPoints*> points;
+  for(const nek5KObject& obj : this->objects)
+  {
+    bytes += obj.bytes;
+    if(obj.points && points.insert(obj.points).second)
+      bytes += static_cast<vtkIdType>(obj.points->GetData()->GetActualMemorySize()) * 1024;
+  }
+  return bytes;
+}
 
-    // if we didn't find it
-    if(curObj == nullptr)
-      {
-      // if we are not over allocated,
-      // create a new object, and put it at the tail
-      if(this->cur_count < this->max_count)
-        {
-        this->cur_count++;
-        //curObj = nek5KObject::New();
-        curObj = new nek5KObject();
-        if (this->head == nullptr)  // if list is empty
-          {
-          this->head = curObj;
-          this->tail = curObj;
-          }
-        else
-          {
-          this->tail->next = curObj;
-          curObj->prev = this->tail;
-          curObj->next = nullptr;
-          this->tail = curObj;
-          }
-        // set the index to the one requested
-        curObj->index = id;
-        }
-      else  // otherwise reuse oldest obj (head), reset and move to tail
-        {
-        curObj = this->head;
-        this->head = this->head->next;
-        this->head->prev = nullptr;
-
-        this->tail->next = curObj;
-        curObj->prev = this->tail;
-        curObj->next = nullptr;
-        this->tail = curObj;
-        curObj->reset();
-        curObj->index = id;
-        }
-      }
-    return(curObj);
+void nek5KCache::clear()
+{
+  this->index.clear();
+  this->objects.clear();
+  this->resident = 0;
+}
+
+void nek5KCache::releaseGrids()
+{
+  for(nek5KObject& obj : this->objects)
+  {
+    if(obj.ugrid)
+    {
+      obj.ugrid->Delete();
+      obj.ugrid = nullptr;
+    }
+  }
+}
+
+namespace
+{
+// the pointers handed out by nek5KMapping::share(), with the mapping they point into
+std::mutex& mappedArraysMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+std::multimap<void*, std::shared_ptr<nek5KMapping>>& mappedArrays()
+{
+  static auto arrays = new std::multimap<void*, std::shared_ptr<nek5KMapping>>;
+  return *arrays;
+}
+}
+
+nek5KMapping::nek5KMapping()
+{
+  this->data = nullptr;
+  this->size = 0;
+}
+
+nek5KMapping::~nek5KMapping()
+{
+#ifndef _WIN32
+  if(this->data)
+    munmap((void*)this->data, this->size);
+#endif
+}
+
+std::shared_ptr<nek5KMapping> nek5KMapping::create(const char* filename)
+{
+#ifndef _WIN32
+  int fd = ::open(filename, O_RDONLY);
+  if(fd < 0)
+    return nullptr;
+  struct stat st;
+  void* addr = MAP_FAILED;
+  if(fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    // private and writable: pages VTK would modify are copied, never written back
+    addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if(addr == MAP_FAILED)
+    return nullptr;
+
+  std::shared_ptr<nek5KMapping> mapping(new nek5KMapping());
+  mapping->data = (const char*)addr;
+  mapping->size = st.st_size;
+  return mapping;
+#else
+  // not available, the caller falls back to std::ifstream
+  (void)filename;
+  return nullptr;
+#endif
+}
+
+void* nek5KMapping::share(const std::shared_ptr<nek5KMapping>& mapping, long offset)
+{
+  void* ptr = (void*)(mapping->data + offset);
+  std::lock_guard<std::mutex> lock(mappedArraysMutex());
+  mappedArrays().emplace(ptr, mapping);
+  return ptr;
+}
+
+vtkDataArray* nek5KMapping::wrap(const std::shared_ptr<nek5KMapping>& mapping, int data_type,
+                                 long offset, long num_values)
+{
+  void* values = nek5KMapping::share(mapping, offset);
+  vtkDataArray* array = vtkDataArray::CreateDataArray(data_type);
+  array->SetVoidArray(values, num_values, 0, vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+  array->SetArrayFreeFunction(nek5KMapping::release);
+  return array;
+}
+
+void nek5KMapping::release(void* ptr)
+{
+  std::lock_guard<std::mutex> lock(mappedArraysMutex());
+  auto it = mappedArrays().find(ptr);
+  if(it != mappedArrays().end())
+    mappedArrays().erase(it);
+}
+
+class nek5KCollectiveFile
+{
+ public:
+  MPI_File handle;
+
+  static std::shared_ptr<nek5KCollectiveFile> open(const char* filename)
+  {
+    MPI_Info info;
+    MPI_Info_create(&info);
+    // ask ROMIO for two-phase collective buffering, whatever the file system
+    MPI_Info_set(info, (char*)"romio_cb_read", (char*)"enable");
+    MPI_File handle;
+    int err = MPI_File_open(MPI_COMM_WORLD, (char*)filename, MPI_MODE_RDONLY, info, &handle);
+    MPI_Info_free(&info);
+    if(err != MPI_SUCCESS)
+      return nullptr;
+    std::shared_ptr<nek5KCollectiveFile> file(new nek5KCollectiveFile);
+    file->handle = handle;
+    return file;
+  }
+
+  ~nek5KCollectiveFile()
+  {
+    MPI_File_close(&this->handle);
+  }
+};
+
+bool nek5KDataFile::open(const char* filename, bool use_mmap, bool use_mpiio)
+{
+  // the stream is also used to parse the ASCII header
+  this->stream.open(filename, std::ifstream::binary);
+  if(use_mpiio)
+  {
+    // the open is collective, and the ranks must agree on how they read:
+    // they fail together, and read with MPI-IO only if all of them can
+    this->collective = nek5KCollectiveFile::open(filename);
+    int opened[2] = { this->stream.is_open() ? 1 : 0, this->collective ? 1 : 0 };
+    MPI_Allreduce(MPI_IN_PLACE, opened, 2, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if(!opened[0])
+    {
+      this->close();
+      return false;
+    }
+    if(!opened[1])
+    {
+      this->collective.reset();
+      std::cerr << "Cannot open " << filename << " with MPI-IO on all ranks, reading it instead" << std::endl;
+    }
+  }
+  if(!this->stream.is_open())
+    return false;
+  if(use_mmap && !this->collective)
+  {
+    this->mapping = nek5KMapping::create(filename);
+    if(!this->mapping)
+      std::cerr << "Cannot map " << filename << ", reading it instead" << std::endl;
+  }
+  return true;
+}
+
+void nek5KDataFile::close()
+{
+  this->stream.close();
+  this->mapping.reset();
+  this->collective.reset();
 }
 
-void ByteSwap32(void *aVals, int nVals)
+bool nek5KDataFile::readAll(const nek5KReadPlan& plan, long first, long count, long base, long block_size, char* dest)
 {
-  char *v = (char *)aVals;
-  char tmp;
-  for (long ii = 0 ; ii < nVals ; ii++, v+=4)
+  // the file view of this rank is made of the parts of its runs of blocks
+  // within first and first+count, and the read counts whole blocks so that
+  // the counts fit in an int
+  MPI_Datatype block_type, file_type;
+  MPI_Type_contiguous(int(block_size), MPI_BYTE, &block_type);
+  MPI_Type_commit(&block_type);
+  std::vector<int> lengths;
+  std::vector<MPI_Aint> displacements;
+  for(const nek5KReadRun& run : plan.runs)
   {
-    tmp = v[0]; v[0] = v[3]; v[3] = tmp;
-    tmp = v[1]; v[1] = v[2]; v[2] = tmp;
+    long begin = std::max(first, long(run.first));
+    long end = std::min(first + count, long(run.first) + run.count);
+    if(begin >= end)
+      continue;
+    lengths.push_back(int(end - begin));
+    displacements.push_back(MPI_Aint(base) + MPI_Aint(run.position + begin - run.first) * block_size);
   }
+  MPI_Type_create_hindexed(int(lengths.size()), lengths.data(), displacements.data(), block_type, &file_type);
+  MPI_Type_commit(&file_type);
+
+  MPI_Status status;
+  int err = MPI_File_set_view(this->collective->handle, 0, MPI_BYTE, file_type, (char*)"native", MPI_INFO_NULL);
+  if(err == MPI_SUCCESS)
+    err = MPI_File_read_at_all(this->collective->handle, 0, dest, int(count), block_type, &status);
+  if(err != MPI_SUCCESS)
+    std::cerr << __LINE__ << ": collective read error for " << count << " blocks of " << block_size << " bytes" << std::endl;
+
+  MPI_Type_free(&file_type);
+  MPI_Type_free(&block_type);
+  return err == MPI_SUCCESS;
 }
 
-void ByteSwap64(void *aVals, int nVals)
+bool nek5KDataFile::read(long offset, long size, char* dest)
 {
-  char *v = (char *)aVals;
-  char tmp;
-  for (long ii = 0 ; ii < nVals ; ii++, v+=8)
+  if(this->mapping)
+  {
+    if(offset + size > long(this->mapping->size))
     {
-    tmp = v[0]; v[0] = v[7]; v[7] = tmp;
-    tmp = v[1]; v[1] = v[6]; v[6] = tmp;
-    tmp = v[2]; v[2] = v[5]; v[5] = tmp;
-    tmp = v[3]; v[3] = v[4]; v[4] = tmp;
+      std::cerr << __LINE__ << ": read error for payload of " << size << " bytes at " << offset << std::endl;
+      return false;
     }
+    memcpy(dest, this->mapping->data + offset, size);
+    return true;
+  }
+
+  this->stream.seekg(offset, std::ios_base::beg );
+  if (!this->stream)
+    std::cerr << __LINE__ << ": seekg error at read_location = " << offset << std::endl;
+  this->stream.read(dest, size);
+  if (!this->stream)
+  {
+    std::cerr << __LINE__ << ": read error for payload of " << size << " bytes" << std::endl;
+    this->stream.clear();
+    return false;
+  }
+  return true;
 }
 
-int compare_ids(const void *id1, const void *id2)
+const char* nek5KDataFile::fetch(long offset, long size, char* buffer)
 {
-  int *a = (int*)id1;
-  int *b = (int*)id2;
-    
-  if(*a<*b)
-    return(-1);
-  if(*a>*b)
-    return(1);
-  return(0);
+  if(this->mapping)
+  {
+    if(offset + size > long(this->mapping->size))
+    {
+      std::cerr << __LINE__ << ": read error for payload of " << size << " bytes at " << offset << std::endl;
+      return nullptr;
+    }
+    return this->mapping->data + offset;
+  }
+  return this->read(offset, size, buffer) ? buffer : nullptr;
+}
+
+void nek5KReadPlan::build(const int* positions, int num_blocks)
+{
+  this->order.resize(num_blocks);
+  for(int j=0; j<num_blocks; j++)
+  {
+    this->order[j] = j;
+  }
+  std::stable_sort(this->order.begin(), this->order.end(),
+                   [positions](int a, int b) { return positions[a] < positions[b]; });
+
+  this->runs.clear();
+  for(int k=0; k<num_blocks; k++)
+  {
+    int j = this->order[k];
+    if(!this->runs.empty())
+    {
+      nek5KReadRun& run = this->runs.back();
+      if(positions[j] == run.position + run.count)
+      {
+        run.direct = run.direct && (j == this->order[k-1] + 1);
+        run.count++;
+        continue;
+      }
+    }
+    this->runs.push_back({ positions[j], k, 1, true });
+  }
 }
+
+void nek5KReadPlan::clear()
+{
+  this->order.clear();
+  this->runs.clear();
+}
+
@@ -1,8 +1,14 @@
 #ifndef __vtkNek5000Reader_h
 #define __vtkNek5000Reader_h
 
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 //#include <string>
@@ -12,6 +18,9 @@ using std::string;
 #include "Nek5000ReaderModule.h" // For export macro
 class vtkPoints;
 class vtkDataArraySelection;
+class vtkDataArray;
+class vtkPartitionedDataSet;
+class vtkCellArray;
 
 
 #define MAX_VARS 100
@@ -24,35 +33,188 @@ class nek5KObject
     bool lambda_2;
     bool wss;
     bool stress_tensor;
-    bool vars[MAX_VARS];
+    bool vars[MAX_VARS];     // the arrays ugrid was made with
     bool der_vars[MAX_VARS];
+    vtkDataArray* arrays[MAX_VARS]; // the arrays of the step read so far, owned
+    // the value ranges of the arrays: the minimum and maximum of each component, element after element
+    std::vector<float> ranges[MAX_VARS];
     int index;
+    vtkIdType bytes; // size of the arrays and of their ranges
+    vtkPoints* points; // the coordinates of the step, shared by the steps of the same geometry
+    size_t points_hash;
+    bool owns_points;  // false if the points are those of another step
+    int mesh_step;     // the step whose data file holds the coordinates
 
-    nek5KObject *prev;
-    nek5KObject *next;
     char * dataFilename;
 
     void setDataFilename(char* filename);
     void reset();
+    // drop the grid, arrays and points, keeping the step
+    void releaseData();
    
 // protected:
     nek5KObject();
     ~nek5KObject();
+    nek5KObject(const nek5KObject&) = delete;
+    void operator=(const nek5KObject&) = delete;
 };
 
 
-class nek5KList
+// The arrays of the steps shown last, each read once per step and variable,
+// with the grid made from them. The arrays and points are kept up to a budget
+// of bytes, the least recently used steps being dropped first. Points shared
+// by several steps are counted once, as long as any of them is kept. The
+// cells, shared by all, are not counted.
+class nek5KCache
 {
  public:
-    nek5KObject* head;
-    nek5KObject* tail;
-    int max_count;
-    int cur_count;
-    nek5KObject* getObject(int);
+    // the object of step 'id', made the most recently used; a new one if missing
+    nek5KObject* getObject(int id);
+    // the object of step 'id', or nullptr, leaving the order unchanged
+    nek5KObject* findObject(int id);
+    // the first object for which 'match' is true, or nullptr
+    template <class Predicate>
+    nek5KObject* findIf(Predicate match)
+    {
+      for(nek5KObject& obj : this->objects)
+      {
+        if(match(obj))
+          return &obj;
+      }
+      return nullptr;
+    }
+    // count the bytes of 'obj' once its grid was set, and drop the least
+    // recently used objects, but the most recent one, while over 'budget'
+    void update(nek5KObject* obj, vtkIdType budget);
+    // the bytes of the arrays of the objects, and of the distinct points they hold
+    vtkIdType countBytes() const;
+    void clear();
+    // drop the grids of the objects, made again from new cells
+    void releaseGrids();
+    vtkIdType residentBytes() const { return this->resident; }
+    int size() const { return static_cast<int>(this->objects.size()); }
 
-// protected:
-    nek5KList();
-    ~nek5KList();
+ private:
+    std::list<nek5KObject> objects; // least recently used first
+    std::map<int, std::list<nek5KObject>::iterator> index;
+    vtkIdType resident = 0;
+};
+
+// A run of spectral elements stored back to back in a data file.
+// 'position' is the file position (block index) of the first element,
+// 'first' the index in nek5KReadPlan::order of the matching local block.
+// 'direct' is true if the local blocks of the run are also consecutive.
+struct nek5KReadRun
+{
+    long position;
+    int first;
+    int count;
+    bool direct;
+};
+
+// Turns the file positions of the local blocks into the smallest list of
+// contiguous byte ranges, so that each range is read with a single request.
+class nek5KReadPlan
+{
+ public:
+    std::vector<int> order;  // local block indices, sorted by file position
+    std::vector<nek5KReadRun> runs;
+
+    void build(const int* positions, int num_blocks);
+    void clear();
+};
+
+// I/O statistics of a read: requests issued, bytes they fetched, and requests
+// the former one-read-per-element scheme would have needed.
+struct nek5KReadStats
+{
+    vtkIdType requests = 0;
+    vtkIdType bytes = 0;
+    vtkIdType per_element_requests = 0;
+};
+
+// The options a step is read with, and the blocks and points of the elements
+// to read. The prefetch thread reads with a copy made when the step is queued,
+// so that the reader can be changed meanwhile.
+struct nek5KReadSettings
+{
+    int dataType;
+    int blockedVectors;
+    int useMemoryMap;
+    bool hasMesh;       // the data file of the step includes the coordinates
+    nek5KReadPlan readPlan;
+    int blockDims[3];   // see vtkNek5000Reader::updateElementSampling()
+    int totalBlockSize;
+    std::vector<long> sampledPoints;
+    std::vector<std::pair<long,long>> sampledRuns;
+    std::vector<double> projection[3];
+};
+
+// A time step read ahead by the prefetch thread, with the options it was
+// asked with. Once 'started', it belongs to the thread until it is 'ready'.
+struct nek5KPrefetchedStep
+{
+    int step;               // in the numbering of the data files
+    std::vector<bool> vars; // the variables to read
+    nek5KReadSettings settings;
+    bool started = false;
+    bool ready = false;
+    bool failed = false;
+    std::vector<vtkDataArray*> arrays;
+    std::vector<std::vector<float>> ranges;
+    nek5KReadStats stats;
+};
+
+// A read-only, copy-on-write mapping of a whole data file.
+class nek5KMapping
+{
+ public:
+    static std::shared_ptr<nek5KMapping> create(const char* filename);
+    // Wrap 'num_values' values of type 'data_type' (VTK_FLOAT or VTK_DOUBLE) of the
+    // mapping, starting at 'offset', in a VTK array without copying them.
+    // The array keeps the mapping alive.
+    static vtkDataArray* wrap(const std::shared_ptr<nek5KMapping>& mapping, int data_type,
+                              long offset, long num_values);
+    // Return the address of 'offset' in the mapping, which stays valid until
+    // release() is called with it. This is the free function of such arrays.
+    static void* share(const std::shared_ptr<nek5KMapping>& mapping, long offset);
+    static void release(void* ptr);
+
+    const char* data;
+    size_t size;
+
+    ~nek5KMapping();
+ private:
+    nek5KMapping();
+};
+
+// An MPI-IO handle on a data file, opened by all ranks together.
+class nek5KCollectiveFile;
+// The header of a geometry cache file.
+struct nek5KGeometryHeader;
+
+// A data file, read either with std::ifstream, through a nek5KMapping, or
+// with collective MPI-IO requests.
+class nek5KDataFile
+{
+ public:
+    std::ifstream stream;
+    std::shared_ptr<nek5KMapping> mapping;
+    std::shared_ptr<nek5KCollectiveFile> collective;
+
+    // with use_mpiio, all ranks must open the file, and read it with readAll(). They
+    // then all succeed or all fail, and all read with MPI-IO or none.
+    bool open(const char* filename, bool use_mmap, bool use_mpiio = false);
+    void close();
+    // read the 'count' blocks of 'plan' from the 'first' one, in file order, into 'dest',
+    // with one collective request of all ranks. Block b of the file starts at
+    // base + b*block_size.
+    bool readAll(const nek5KReadPlan& plan, long first, long count, long base, long block_size, char* dest);
+    // copy 'size' bytes located at 'offset' into 'dest'
+    bool read(long offset, long size, char* dest);
+    // get 'size' bytes located at 'offset', from the mapping if there is one,
+    // otherwise by reading them into 'buffer'; nullptr if they cannot be read
+    const char* fetch(long offset, long size, char* buffer);
 };
 
 class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorithm
@@ -76,9 +238,45 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   vtkGetVector2Macro(TimeStepRange,int);
   vtkSetVector2Macro(TimeStepRange,int);
   
-//  // set/get the resolution to use for each element of the input grid
-//  void SetElementResolution(int);
-//  vtkGetMacro(ElementResolution, int);
+// used for ParaView to decide the resolution of each element: only every ElementStride-th GLL point
+// is read in each direction, with the last one, so that the elements keep their extent. 1 reads all
+// points, 0 the corners of the elements only.
+  vtkSetClampMacro(ElementStride, int, 0, VTK_INT_MAX);
+  vtkGetMacro(ElementStride, int);
+
+// used for ParaView to decide if the fields and coordinates of each element are interpolated on
+// read to the GLL points of a lower polynomial order (0 keeps the order of the files). The
+// ElementStride is then not used.
+  vtkSetClampMacro(ProjectionOrder, int, 0, VTK_INT_MAX);
+  vtkGetMacro(ProjectionOrder, int);
+
+// used for ParaView to decide if only the spectral elements whose bounding box intersects a
+// region are read and output: 0 all elements, 1 the box RegionBounds, 2 the slab of
+// RegionThickness centered on the plane of RegionOrigin and RegionNormal. The bounds of the
+// elements are those of the first mesh, saved next to the dataset.
+  vtkSetClampMacro(RegionOfInterest, int, 0, 2);
+  vtkGetMacro(RegionOfInterest, int);
+  vtkSetVector6Macro(RegionBounds, double);
+  vtkGetVector6Macro(RegionBounds, double);
+  vtkSetVector3Macro(RegionOrigin, double);
+  vtkGetVector3Macro(RegionOrigin, double);
+  vtkSetVector3Macro(RegionNormal, double);
+  vtkGetVector3Macro(RegionNormal, double);
+  vtkSetClampMacro(RegionThickness, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(RegionThickness, double);
+
+// used for ParaView to decide if only the spectral elements where the point array ValueArrayName
+// has values within ValueRange are output, e.g. those an isosurface or a threshold goes through
+// (an isovalue is a range of a single value). The minimum and maximum of the arrays over each
+// element are found when they are read. The array must be a scalar among those read; otherwise,
+// all elements are output.
+  vtkSetMacro(ValueOfInterest, int);
+  vtkGetMacro(ValueOfInterest, int);
+  vtkBooleanMacro(ValueOfInterest, int);
+  vtkSetStringMacro(ValueArrayName);
+  vtkGetStringMacro(ValueArrayName);
+  vtkSetVector2Macro(ValueRange, double);
+  vtkGetVector2Macro(ValueRange, double);
 
   // Description:
   // Get the number of point arrays available in the input.
@@ -98,6 +296,78 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   vtkSetMacro(SpectralElementIds, int); 
   vtkGetMacro(SpectralElementIds, int);
   vtkBooleanMacro(SpectralElementIds, int);
+
+// used for ParaView to decide if the data files are memory-mapped instead of read.
+// Single precision fields with the native byte order are then used in place.
+  vtkSetMacro(UseMemoryMap, int);
+  vtkGetMacro(UseMemoryMap, int);
+  vtkBooleanMacro(UseMemoryMap, int);
+
+// used for ParaView to decide if vectors are kept in the per-element layout of the files
+// (vtkNek5000BlockedArray) instead of being reordered as tuples. Off by default: filters
+// writing through GetVoidPointer() write to a copy, and their changes are lost.
+  vtkSetMacro(BlockedVectors, int);
+  vtkGetMacro(BlockedVectors, int);
+  vtkBooleanMacro(BlockedVectors, int);
+
+// used for ParaView to decide if files written in double precision give double arrays
+// and points, instead of being converted to float
+  vtkSetMacro(DoublePrecision, int);
+  vtkGetMacro(DoublePrecision, int);
+  vtkBooleanMacro(DoublePrecision, int);
+
+// used for ParaView to decide if opening a dataset reads only the headers of the first and last
+// steps. The times of the steps come from the optional "times:" line of the .nek5000 file,
+// or are spaced evenly between those two.
+  vtkSetMacro(FastOpen, int);
+  vtkGetMacro(FastOpen, int);
+  vtkBooleanMacro(FastOpen, int);
+
+// used for ParaView to decide if the ranks read the data files together, with collective
+// MPI-IO requests, instead of each on its own. Ignored if MPI is not initialized.
+  vtkSetMacro(UseMPIIO, int);
+  vtkGetMacro(UseMPIIO, int);
+  vtkBooleanMacro(UseMPIIO, int);
+
+// used for ParaView to decide how many of the next time steps are read ahead by a
+// background thread while the current one is shown (0 turns prefetching off)
+  vtkSetClampMacro(PrefetchDepth, int, 0, 16);
+  vtkGetMacro(PrefetchDepth, int);
+
+// used for ParaView to decide in which direction to read ahead: 1 forward, -1 backward,
+// 0 follows the direction of the last change of time step
+  vtkSetClampMacro(PrefetchDirection, int, -1, 1);
+  vtkGetMacro(PrefetchDirection, int);
+
+// used for ParaView to decide how many megabytes of point data of the steps already shown
+// are kept in memory, to show them again without reading them (0 keeps the current step only)
+  vtkSetClampMacro(CacheSize, int, 0, VTK_INT_MAX);
+  vtkGetMacro(CacheSize, int);
+
+// used for ParaView to decide if the cells and first points built for each rank are saved next
+// to the dataset, and mapped in memory by the next sessions instead of being built again
+  vtkSetMacro(GeometryCache, int);
+  vtkGetMacro(GeometryCache, int);
+  vtkBooleanMacro(GeometryCache, int);
+
+// used for ParaView to decide if the reader keeps a single copy of each field and of the
+// geometry: only the step shown is cached, nothing is read ahead, and with CleanGrid only the
+// merged grid is kept
+  vtkSetMacro(LowMemory, int);
+  vtkGetMacro(LowMemory, int);
+  vtkBooleanMacro(LowMemory, int);
+
+// used for ParaView to decide if each spectral element is output as a single Lagrange hexahedron
+// (quadrilateral in 2D) of all its GLL points, instead of being split into linear cells
+  vtkSetMacro(HighOrderCells, int);
+  vtkGetMacro(HighOrderCells, int);
+  vtkBooleanMacro(HighOrderCells, int);
+
+// used for ParaView to decide if the output is a vtkPartitionedDataSet of one vtkStructuredGrid per
+// spectral element, using the points and arrays of the step in place, instead of an unstructured grid
+  vtkSetMacro(StructuredOutput, int);
+  vtkGetMacro(StructuredOutput, int);
+  vtkBooleanMacro(StructuredOutput, int);
   
   // Description:
   // Get/Set whether the point array with the given name or index is to
@@ -134,6 +404,33 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   // Get the names of variables stored in the data
   int GetVariableNamesFromData(char* varTags);
 
+  // Description:
+  // I/O statistics of the last update: the number of read requests issued,
+  // the number of bytes they fetched, and the number of requests the former
+  // one-read-per-element scheme would have needed for the same data.
+  vtkGetMacro(NumberOfReadRequests, vtkIdType);
+  vtkGetMacro(NumberOfBytesRead, vtkIdType);
+  vtkGetMacro(NumberOfPerElementReadRequests, vtkIdType);
+
+  // Description:
+  // Number of time steps found already read by the prefetch thread (hits),
+  // and of time steps that had to be read on request while prefetching was
+  // on (misses), since the reader was created.
+  vtkGetMacro(NumberOfPrefetchHits, vtkIdType);
+  vtkGetMacro(NumberOfPrefetchMisses, vtkIdType);
+
+  // Description:
+  // Bytes of point data held by the cache of the steps shown, and the number
+  // of steps it holds, on this rank.
+  vtkIdType GetCacheResidentBytes();
+  int GetNumberOfCachedSteps();
+
+  // Description:
+  // Largest number of bytes held by the reader at the end of an update on this
+  // rank: arrays and points of the cached steps and of the steps read ahead,
+  // cells, and the merged output grid with CleanGrid.
+  vtkGetMacro(PeakMemoryBytes, vtkIdType);
+
   int CanReadFile(const char* fname);
  protected:
   vtkNek5000Reader();
@@ -141,14 +438,14 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
 
   char* FileName;
   char* DataFileName;
-//  int ElementResolution;
 //  int BoundaryResolution;
   int nfields;
 //  int my_patch_id;
 
   int num_vars; // all vars including Pressure, Velocity, Velocity Magnitude and Temperature
   char** var_names;
-  float** dataArray;
+  std::vector<vtkDataArray*> dataArray; // point-data arrays just read, in place, before curObj takes them
+  std::vector<std::vector<float>> dataRanges; // the value ranges of dataArray, see nek5KObject::ranges
   int num_der_vars;
   
   int* var_length;
@@ -163,18 +460,30 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   bool* use_variable;
 
   //Tri* T;
-  nek5KList *myList;
+  nek5KCache *myCache;
   nek5KObject *curObj;
   int displayed_step;
   int memory_step;
   int requested_step;
 
-  float * meshCoords;
+  vtkDataArray* meshCoords; // X, Y and Z blocks of each of my elements, as read
+  vtkPoints* geometryPoints; // the points of the first mesh, from the geometry cache file
+  bool geometry_saved; // the geometry cache file matches the grid
+  bool high_order_cells; // UGrid holds one Lagrange cell per element
+  // the points merged by mergePoints(), from the cells of UGrid and the points of this hash
+  vtkPoints* mergedPoints;
+  vtkCellArray* mergedCells;
+  size_t merged_points_hash;
+  std::vector<vtkIdType> mergedSource; // the point each merged point is taken from
+  int dataType; // VTK_FLOAT or VTK_DOUBLE, type of the arrays and points read
 
   std::string datafile_format;
   int datafile_start;
   int datafile_num_steps;
   bool* timestep_has_mesh;
+  std::vector<bool> timestep_mesh_known; // false for the headers not read yet, with FastOpen
+  std::vector<int> timestep_mesh_step;   // what meshStepOf() found for each step, -1 if not asked yet
+  std::vector<double> listed_times; // from the "times:" line of the .nek5000 file
 
 //  void setActive();  // set my_patch_id as the active one
 //  static int getNextPatchID(){return(next_patch_id++);}
@@ -184,11 +493,94 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   // update which fields from the data should be used, based on GUI
   void updateVariableStatus();
   void partitionAndReadMesh();
-  void readData(char* dfName);
+  // make elementBounds, from the index file next to FileName or from the coordinates of the
+  // first mesh, 'elements' being the elements of the file in the order they are partitioned in
+  void updateElementBounds(nek5KDataFile& dataFile, const std::vector<int>& elements,
+                           const std::map<int,int>& blockMap);
+  // the RegionOfInterest settings, empty if all elements are read
+  std::vector<double> regionSettings();
+  // see if the element of bounds 'bounds' intersects the region of interest
+  bool elementInRegion(const float* bounds);
+  // false if they cannot be read
+  bool readMeshCoords(int step_index);
+  // the step whose file holds the coordinates of 'step_index'; to be called by all ranks
+  int meshStepOf(int step_index);
+  // give curObj the points of its step, read or shared with a cached step; false if they cannot be read
+  bool updateStepPoints();
+  // output my elements as structured grids of the points and arrays of curObj
+  void updatePartitions(vtkPartitionedDataSet* output);
+  // see which of my elements have values of interest, from the value ranges of curObj;
+  // false if all of them are output
+  bool selectValueElements(std::vector<char>& keep);
+  // keep only the cells of the elements of 'keep' in 'pv_ugrid'
+  void keepElementCells(vtkUnstructuredGrid* pv_ugrid, const std::vector<char>& keep);
+  // make the cells of UGrid, once
+  void updateCells();
+  bool readData(char* dfName);
+  // read the variables 'vars' of the file 'dfName' with 'settings', into 'arrays', and
+  // their value ranges per element into 'ranges'. Called by the prefetch thread too,
+  // so it leaves the reader unchanged.
+  bool readStep(const char* dfName, const nek5KReadSettings& settings, const std::vector<bool>& vars,
+                std::vector<vtkDataArray*>& arrays, std::vector<std::vector<float>>& ranges,
+                nek5KReadStats& stats, bool collective);
+  // the current read options, blocks and sampling, but hasMesh which is left false
+  nek5KReadSettings readSettings();
+  // see if the data files are to be read with collective MPI-IO requests
+  bool useCollectiveIO();
+  // read variable i, starting at 'offset' in the file, into a new array of type T; nullptr
+  // if it cannot be read
+  template <class T>
+  vtkDataArray* readVariable(nek5KDataFile& dataFile, const nek5KReadSettings& settings, int i, long offset,
+                             long block_size, bool needMagnitude,
+                             std::vector<vtkDataArray*>& arrays, nek5KReadStats& stats);
+  void addReadStats(const nek5KReadStats& stats);
+  // bytes held by the reader, and their maximum in PeakMemoryBytes
+  vtkIdType residentBytes(vtkUnstructuredGrid* output);
+  void updatePeakMemory(vtkUnstructuredGrid* output);
+  void releaseDataArrays();
+  // the type of the arrays read: double if asked for and the files are in double precision
+  int outputDataType();
+  // see if the elements are made Lagrange cells: asked for, and of the same order in each direction
+  bool useHighOrderCells();
+  // read the blocks listed in the read plan of 'settings', converting them to T; false if
+  // any of them cannot be read
+  template <class T>
+  bool readBlocks(nek5KDataFile& dataFile, const nek5KReadSettings& settings, long base, long block_size,
+                  T* dest, long dest_stride, nek5KReadStats& stats);
+  // convert the 'num_vals' values of the file block 'src' into 'dst', keeping the points of
+  // sampledPoints or interpolating them with 'projection' of 'settings', and pad them with
+  // zeros up to 'dest_stride' values. 'scratch' is working space.
+  template <class T>
+  void storeBlock(const nek5KReadSettings& settings, const char* src, long num_vals, T* dst, long dest_stride,
+                  std::vector<double>& scratch);
+  // make blockDims, and sampledPoints or projection, from fileBlockDims, ElementStride and ProjectionOrder
+  void updateElementSampling();
+  // see if variable i, whose blocks start at 'offset', can be used straight from the memory-mapped file
+  bool canMapVariable(nek5KDataFile& dataFile, const nek5KReadSettings& settings, int i, long offset,
+                      long block_size);
+  // hand the arrays just read over to curObj
+  void cacheDataArrays();
   // copy the data from nek5000 to pv
   void updateVtuData(vtkUnstructuredGrid* pv_ugrid); //, vtkUnstructuredGrid* pv_boundary_ugrid);
+  // copy the grid of a step to pv, merging its points if CleanGrid
+  void outputGrid(vtkUnstructuredGrid* grid, vtkUnstructuredGrid* pv_ugrid);
+  // merge the points the elements of 'grid' share, into pv_ugrid
+  void mergePoints(vtkUnstructuredGrid* grid, vtkUnstructuredGrid* pv_ugrid);
+  void releaseMergedPoints();
   void addCellsToContinuumMesh();
   void addSpectralElementId(int nelements);
+  // the geometry cache file of this rank, what it must match, and its use
+  std::string geometryCacheName();
+  void geometryCacheKey(nek5KGeometryHeader& header);
+  bool loadGeometry();
+  void saveGeometry(vtkPoints* points);
+  // the geometry shared by the readers of the process
+  std::string cellsKey();
+  bool shareCells();
+  void registerCells();
+  std::string pointsSource(int mesh_step);
+  vtkPoints* findSharedPoints(const std::string& source, vtkPoints* points, size_t hash);
+  void registerPoints(const std::string& source, vtkPoints* points, size_t hash);
   void copyContinuumPoints(vtkPoints* points);
   // void interpolateAndCopyContinuumData(vtkUnstructuredGrid* pv_ugrid, double **data_array, int interp_res, int num_verts);
   void copyContinuumData(vtkUnstructuredGrid* pv_ugrid);
@@ -196,12 +588,29 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
 //  void interpolateAndCopyBoundaryData(int alloc_res, int num_verts, int interp_res);
 //  void addCellsToBoundaryMesh(int * boundary_index, int qa);
 //  void generateBoundaryConnectivity(int * boundary_index, int res);
-  // see if the current object is missing data that was requested
+  // see if the current object is missing arrays that were requested
   bool isObjectMissingData();
   // see if the current object matches the request
   bool objectMatchesRequest();
-  // see if the current object has extra data than was requested
-  bool objectHasExtraData();
+  // see if the grid of a step is in myCache, with the variables requested
+  bool isStepInList(int step);
+
+  // read ahead of the steps shown, in prefetchThread
+  void schedulePrefetch();
+  // see if a step read ahead has the type and layout of arrays now asked for
+  bool isPrefetchMatching(const nek5KPrefetchedStep& prefetched);
+  // drop the steps not started, and wait for the one being read
+  void waitForPrefetch();
+  // use the arrays of the requested step if they were read ahead, waiting for them if being read
+  bool takePrefetchedStep();
+  void discardPrefetchedSteps();
+  void prefetchLoop();
+  std::thread prefetchThread;
+  std::mutex prefetchMutex;
+  std::condition_variable prefetchCondition;
+  std::list<nek5KPrefetchedStep> prefetchedSteps;
+  bool prefetchQuit;
+  int previous_step; // step shown before the current one, for the direction
 
   vtkUnstructuredGrid* UGrid;
 //  vtkUnstructuredGrid* Boundary_UGrid;
@@ -219,8 +628,19 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   bool MeshIs3D;
   //int TimeStep;
   int precision;
-  int blockDims[3];
+  int blockDims[3]; // of the elements output, with the points kept of each element
   int totalBlockSize;
+  int fileBlockDims[3]; // of the elements in the data files
+  int fileBlockSize;
+  int element_stride; // the ElementStride blockDims were made with
+  std::vector<long> sampledPoints; // the points of a file element which are kept, empty if all of them
+  // the first value and number of values of the runs of rows of a component of a file element
+  // holding the points kept, empty if all of them are kept
+  std::vector<std::pair<long,long>> sampledRuns;
+  int projection_order; // the ProjectionOrder blockDims were made with
+  // per direction, the matrix interpolating the values at the GLL points of the file
+  // elements to those of the projected elements, row after row, empty if not projected
+  std::vector<double> projection[3];
   int ActualTimeStep;
   int numBlocks;
   int myNumBlocks;
@@ -228,6 +648,16 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   int *myBlockIDs;
   int *proc_numBlocks;
   int *myBlockPositions;
+  std::vector<int> myElementIndices; // of my blocks in the list of all elements, for their ids
+  std::vector<float> elementBounds; // xmin, xmax, ymin, ymax, zmin, zmax of each element of the file
+  std::vector<double> region_applied; // the regionSettings() the blocks were selected with
+  nek5KReadPlan readPlan;
+  vtkIdType NumberOfReadRequests;
+  vtkIdType NumberOfBytesRead;
+  vtkIdType NumberOfPerElementReadRequests;
+  vtkIdType NumberOfPrefetchHits;
+  vtkIdType NumberOfPrefetchMisses;
+  vtkIdType PeakMemoryBytes;
   int NumberOfTimeSteps;
   double TimeValue;
   int TimeStepRange[2];
@@ -243,10 +673,27 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   // Fills the TimestepValues array.
   void GetAllTimesAndVariableNames(vtkInformationVector*);
 
+  // Get the time, mesh flag and variable tags of every step, from the index
+  // file next to FileName or from the headers of the data files. Done on rank 0.
+  void scanTimeSteps(char* firstTags);
+  // same, from the headers of the first and last steps only
+  void scanFirstAndLastSteps(char* firstTags);
+  // see if the file of a step includes the mesh, reading its header if not known yet
+  bool stepHasMesh(int step_index);
+
   // Description:
   // Populates the TIME_STEPS and TIME_RANGE keys based on file metadata.
   void AdvertiseTimeSteps( vtkInformation* outputInfo );
 
+  // the output is an unstructured grid, or a partitioned dataset with StructuredOutput
+  virtual vtkTypeBool ProcessRequest(vtkInformation* request,
+                                     vtkInformationVector** inputVector,
+                                     vtkInformationVector* outputVector);
+  virtual int RequestDataObject(vtkInformation* request,
+                                vtkInformationVector** inputVector,
+                                vtkInformationVector* outputVector);
+  virtual int FillOutputPortInformation(int port, vtkInformation* info);
+
   virtual int RequestInformation(vtkInformation* request,
                                  vtkInformationVector** inputVector,
                                  vtkInformationVector* outputVector);
@@ -264,6 +711,28 @@ class NEK5000READER_EXPORT vtkNek5000Reader : public vtkUnstructuredGridAlgorith
   
   int SpectralElementIds;
   int CleanGrid;
+  int UseMemoryMap;
+  int BlockedVectors;
+  int DoublePrecision;
+  int PrefetchDepth;
+  int PrefetchDirection;
+  int UseMPIIO;
+  int FastOpen;
+  int CacheSize;
+  int GeometryCache;
+  int LowMemory;
+  int HighOrderCells;
+  int StructuredOutput;
+  int ElementStride;
+  int ProjectionOrder;
+  int RegionOfInterest;
+  double RegionBounds[6];
+  double RegionOrigin[3];
+  double RegionNormal[3];
+  double RegionThickness;
+  int ValueOfInterest;
+  char* ValueArrayName;
+  double ValueRange[2];
 };
 
 #endif
@@ -0,0 +1,146 @@
+// A small dataset written by the tests: one step of NUM_ELEMENTS elements of
+// ORDER^3 points in double precision, side by side along x, element e
+// covering [e, e+1] x [0, 1] x [0, 1] with its points at the GLL points, with
+// mesh, velocity and pressure. The tests read it with the option they cover
+// and compare the output with a full read.
+
+#ifndef TestReaderDataset_h
+#define TestReaderDataset_h
+
+#include "vtkDataArray.h"
+#include "vtkNek5000Reader.h"
+#include "vtkPointData.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#define NUM_ELEMENTS 4
+#define ORDER 5 // GLL points per direction
+#define BLOCK_SIZE (ORDER*ORDER*ORDER)
+
+// the pressure written at point (x, y, z), linear so that any interpolation
+// of the element reproduces it, and growing with the element
+static double pressureAt(double x, double y, double z)
+{
+  return 100.0*x + 10.0*y + z + 0.5;
+}
+
+// the GLL point i of ORDER in [0, 1]
+static double gllPoint(int i)
+{
+  static const double points[ORDER] = { -1.0, -std::sqrt(21.0)/7.0, 0.0, std::sqrt(21.0)/7.0, 1.0 };
+  return 0.5 * (points[i] + 1.0);
+}
+
+// 'prefix'.nek5000 and its data file; the coordinates of the odd elements are
+// moved by 'jitter'
+static bool writeDataset(const std::string& prefix, double jitter = 0.0)
+{
+  std::ofstream meta((prefix + ".nek5000").c_str());
+  meta << "filetemplate: " << prefix << "%01d.f%05d\n"
+       << "firsttimestep: 1\n"
+       << "numtimesteps: 1\n";
+  meta.close();
+
+  std::string dataName = prefix + "0.f00001";
+  std::ofstream data(dataName.c_str(), std::ofstream::binary);
+  char header[132];
+  memset(header, ' ', sizeof(header));
+  int length = snprintf(header, sizeof(header), "#std 8 %d %d %d %d %d 0.0000000E+00 0 0 1 XUP",
+                        ORDER, ORDER, ORDER, NUM_ELEMENTS, NUM_ELEMENTS);
+  header[length] = ' ';
+  data.write(header, sizeof(header));
+  float endian = 6.54321f;
+  data.write((const char*)&endian, 4);
+  for(int32_t e=1; e<=NUM_ELEMENTS; e++)
+    data.write((const char*)&e, 4);
+
+  double x[NUM_ELEMENTS][BLOCK_SIZE], y[NUM_ELEMENTS][BLOCK_SIZE], z[NUM_ELEMENTS][BLOCK_SIZE];
+  for(int e=0; e<NUM_ELEMENTS; e++)
+  {
+    double shift = (e % 2) ? jitter : 0.0;
+    for(int p=0; p<BLOCK_SIZE; p++)
+    {
+      x[e][p] = e + gllPoint(p % ORDER) + shift;
+      y[e][p] = gllPoint((p / ORDER) % ORDER) + shift;
+      z[e][p] = gllPoint(p / (ORDER*ORDER)) + shift;
+    }
+  }
+  // the coordinates, X then Y then Z of each element
+  for(int e=0; e<NUM_ELEMENTS; e++)
+  {
+    data.write((const char*)x[e], sizeof(x[e]));
+    data.write((const char*)y[e], sizeof(y[e]));
+    data.write((const char*)z[e], sizeof(z[e]));
+  }
+  // the velocity, zero
+  double zero[3*BLOCK_SIZE] = {};
+  for(int e=0; e<NUM_ELEMENTS; e++)
+    data.write((const char*)zero, sizeof(zero));
+  // the pressure
+  for(int e=0; e<NUM_ELEMENTS; e++)
+  {
+    double p_values[BLOCK_SIZE];
+    for(int p=0; p<BLOCK_SIZE; p++)
+      p_values[p] = pressureAt(x[e][p], y[e][p], z[e][p]);
+    data.write((const char*)p_values, sizeof(p_values));
+  }
+  data.close();
+  return bool(data);
+}
+
+// the files of the dataset, with those the reader writes next to it
+static void removeDataset(const std::string& prefix)
+{
+  std::remove((prefix + "0.f00001").c_str());
+  std::remove((prefix + ".nek5000").c_str());
+  std::remove((prefix + ".nek5000.idx").c_str());
+  std::remove((prefix + ".nek5000.bounds").c_str());
+}
+
+// read the pressure of the dataset 'prefix' with 'reader', set up by the test
+static vtkUnstructuredGrid* readPressure(vtkNek5000Reader* reader, const std::string& prefix)
+{
+  std::string metaName = prefix + ".nek5000";
+  reader->SetFileName(metaName.c_str());
+  reader->SetDoublePrecision(1);
+  reader->UpdateInformation();
+  reader->DisableAllPointArrays();
+  reader->SetPointArrayStatus("Pressure", 1);
+  reader->Update();
+  vtkUnstructuredGrid* output = reader->GetOutput();
+  if(!output || !output->GetPointData()->GetArray("Pressure"))
+  {
+    std::cerr << "no pressure read from " << metaName << "\n";
+    return nullptr;
+  }
+  return output;
+}
+
+// point i of 'output' has the coordinates and pressure of point j of 'full',
+// within 'tolerance'
+static bool samePoint(vtkUnstructuredGrid* output, vtkIdType i, vtkUnstructuredGrid* full, vtkIdType j,
+                      double tolerance = 0.0)
+{
+  double a[3], b[3];
+  output->GetPoint(i, a);
+  full->GetPoint(j, b);
+  double pa = output->GetPointData()->GetArray("Pressure")->GetTuple1(i);
+  double pb = full->GetPointData()->GetArray("Pressure")->GetTuple1(j);
+  if(std::fabs(a[0] - b[0]) > tolerance || std::fabs(a[1] - b[1]) > tolerance ||
+     std::fabs(a[2] - b[2]) > tolerance || std::fabs(pa - pb) > 100.0 * tolerance)
+  {
+    std::cerr << "point " << i << " (" << a[0] << ", " << a[1] << ", " << a[2] << "; " << pa << ") instead of ("
+              << b[0] << ", " << b[1] << ", " << b[2] << "; " << pb << ")\n";
+    return false;
+  }
+  return true;
+}
+
+#endif
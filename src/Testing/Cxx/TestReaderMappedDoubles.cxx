@@ -0,0 +1,134 @@
+// Read a memory-mapped, double precision dataset with an odd number of
+// elements. The values then follow a header of 136 + 4*3 bytes, which is not a
+// multiple of 8: the reader must read them into an array of its own instead of
+// handing out misaligned doubles from the mapping.
+
+#include "vtkDataArray.h"
+#include "vtkNek5000Reader.h"
+#include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#define NUM_ELEMENTS 3
+#define ORDER 2 // GLL points per direction
+
+// the pressure written at point (x, y, z)
+static double pressureAt(double x, double y, double z)
+{
+  return x + 10.0*y + 100.0*z + 0.5;
+}
+
+// one step of NUM_ELEMENTS elements of ORDER^3 points, with mesh, velocity and pressure
+static bool writeDataset(const char* metaName, const char* dataName)
+{
+  std::ofstream meta(metaName);
+  meta << "filetemplate: TestReaderMappedDoubles%01d.f%05d\n"
+       << "firsttimestep: 1\n"
+       << "numtimesteps: 1\n";
+  meta.close();
+
+  std::ofstream data(dataName, std::ofstream::binary);
+  char header[132];
+  memset(header, ' ', sizeof(header));
+  int length = snprintf(header, sizeof(header), "#std 8 %d %d %d %d %d 0.0000000E+00 0 0 1 XUP",
+                        ORDER, ORDER, ORDER, NUM_ELEMENTS, NUM_ELEMENTS);
+  header[length] = ' ';
+  data.write(header, sizeof(header));
+  float endian = 6.54321f;
+  data.write((const char*)&endian, 4);
+  for(int32_t e=1; e<=NUM_ELEMENTS; e++)
+    data.write((const char*)&e, 4);
+
+  const int block_size = ORDER*ORDER*ORDER;
+  double x[block_size], y[block_size], z[block_size];
+  // the coordinates, X then Y then Z of each element
+  for(int e=0; e<NUM_ELEMENTS; e++)
+  {
+    for(int p=0; p<block_size; p++)
+    {
+      x[p] = e + p % ORDER;
+      y[p] = (p / ORDER) % ORDER;
+      z[p] = p / (ORDER*ORDER);
+    }
+    data.write((const char*)x, sizeof(x));
+    data.write((const char*)y, sizeof(y));
+    data.write((const char*)z, sizeof(z));
+  }
+  // the velocity, zero
+  double zero[3*block_size] = {};
+  for(int e=0; e<NUM_ELEMENTS; e++)
+    data.write((const char*)zero, sizeof(zero));
+  // the pressure
+  for(int e=0; e<NUM_ELEMENTS; e++)
+  {
+    double p_values[block_size];
+    for(int p=0; p<block_size; p++)
+      p_values[p] = pressureAt(e + p % ORDER, (p / ORDER) % ORDER, p / (ORDER*ORDER));
+    data.write((const char*)p_values, sizeof(p_values));
+  }
+  data.close();
+  return bool(data);
+}
+
+int main(int, char**)
+{
+  const char* metaName = "TestReaderMappedDoubles.nek5000";
+  const char* dataName = "TestReaderMappedDoubles0.f00001";
+  if(!writeDataset(metaName, dataName))
+  {
+    std::cerr << "cannot write " << dataName << "\n";
+    return EXIT_FAILURE;
+  }
+
+  vtkNew<vtkNek5000Reader> reader;
+  reader->SetFileName(metaName);
+  reader->SetUseMemoryMap(1);
+  reader->SetDoublePrecision(1);
+  reader->UpdateInformation();
+  reader->DisableAllPointArrays();
+  reader->SetPointArrayStatus("Pressure", 1);
+  reader->Update();
+
+  int status = EXIT_SUCCESS;
+  vtkUnstructuredGrid* output = reader->GetOutput();
+  vtkDataArray* pressure = output->GetPointData()->GetArray("Pressure");
+  if(!pressure || pressure->GetDataType() != VTK_DOUBLE ||
+     output->GetNumberOfPoints() != NUM_ELEMENTS*ORDER*ORDER*ORDER)
+  {
+    std::cerr << "expected " << NUM_ELEMENTS*ORDER*ORDER*ORDER << " points with a double pressure\n";
+    status = EXIT_FAILURE;
+  }
+  else
+  {
+    if(reinterpret_cast<uintptr_t>(pressure->GetVoidPointer(0)) % sizeof(double) != 0)
+    {
+      std::cerr << "the pressure values are not aligned for doubles\n";
+      status = EXIT_FAILURE;
+    }
+    for(vtkIdType i=0; i<output->GetNumberOfPoints(); i++)
+    {
+      double point[3];
+      output->GetPoint(i, point);
+      double expected = pressureAt(point[0], point[1], point[2]);
+      if(pressure->GetTuple1(i) != expected)
+      {
+        std::cerr << "point " << i << ": pressure " << pressure->GetTuple1(i) << " instead of " << expected << "\n";
+        status = EXIT_FAILURE;
+        break;
+      }
+    }
+  }
+
+  std::remove(dataName);
+  std::remove(metaName);
+  std::remove("TestReaderMappedDoubles.nek5000.idx");
+  return status;
+}
@@ -0,0 +1,71 @@
+// Read a dataset with CleanGrid: the points shared by adjacent elements must
+// be merged, and each cell must keep the points of a full read. The odd
+// elements are then moved by a fraction of the merging tolerance, so that
+// coincident points straddle a boundary of the rounding of the coordinates;
+// they must still be merged.
+
+#include "TestReaderDataset.h"
+
+#include "vtkIdList.h"
+#include "vtkNew.h"
+
+#include <cstdlib>
+
+static bool checkMerge(const std::string& prefix, double jitter)
+{
+  vtkNew<vtkNek5000Reader> reader;
+  vtkUnstructuredGrid* full = readPressure(reader, prefix);
+  vtkNew<vtkNek5000Reader> merging;
+  merging->SetCleanGrid(1);
+  vtkUnstructuredGrid* output = readPressure(merging, prefix);
+  if(!full || !output)
+    return false;
+
+  // the faces between the elements are merged
+  vtkIdType expected = NUM_ELEMENTS * BLOCK_SIZE - (NUM_ELEMENTS-1) * ORDER*ORDER;
+  if(output->GetNumberOfPoints() != expected || output->GetNumberOfCells() != full->GetNumberOfCells())
+  {
+    std::cerr << "jitter " << jitter << ": " << output->GetNumberOfPoints() << " points and "
+              << output->GetNumberOfCells() << " cells instead of " << expected << " and "
+              << full->GetNumberOfCells() << "\n";
+    return false;
+  }
+  vtkNew<vtkIdList> cell, full_cell;
+  for(vtkIdType c=0; c<output->GetNumberOfCells(); c++)
+  {
+    output->GetCellPoints(c, cell);
+    full->GetCellPoints(c, full_cell);
+    if(cell->GetNumberOfIds() != full_cell->GetNumberOfIds())
+    {
+      std::cerr << "jitter " << jitter << ": cell " << c << " of " << cell->GetNumberOfIds() << " points\n";
+      return false;
+    }
+    for(vtkIdType p=0; p<cell->GetNumberOfIds(); p++)
+    {
+      if(!samePoint(output, cell->GetId(p), full, full_cell->GetId(p), 2.0 * jitter))
+      {
+        std::cerr << "jitter " << jitter << ": wrong point of cell " << c << "\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int, char**)
+{
+  std::string prefix = "TestReaderMergePoints";
+  // the reader merges within 1/1000 of the distance between the first two
+  // points of an element; a shift of 0.6 of it moves the coordinates 0 of
+  // the odd elements past the first boundary of rounding to that tolerance
+  double tolerance = (gllPoint(1) - gllPoint(0)) / 1000.0;
+  int status = EXIT_SUCCESS;
+  if(!writeDataset(prefix) || !checkMerge(prefix, 0.0) ||
+     !writeDataset(prefix, 0.6 * tolerance) || !checkMerge(prefix, 0.6 * tolerance))
+  {
+    status = EXIT_FAILURE;
+  }
+
+  removeDataset(prefix);
+  return status;
+}
@@ -0,0 +1,83 @@
+// Read a dataset with a ProjectionOrder: the elements are interpolated to the
+// GLL points of the lower order, which reproduces the linear pressure and
+// coordinates exactly. The corners of each element must be those of a full
+// read, and its other points at the GLL points of the lower order.
+
+#include "TestReaderDataset.h"
+
+#include "vtkNew.h"
+
+#include <cstdlib>
+
+#define TOLERANCE 1e-9
+
+static bool checkProjection(const std::string& prefix, vtkUnstructuredGrid* full, int order)
+{
+  vtkNew<vtkNek5000Reader> reader;
+  reader->SetProjectionOrder(order);
+  vtkUnstructuredGrid* output = readPressure(reader, prefix);
+  if(!output)
+    return false;
+
+  int n = order + 1;
+  if(output->GetNumberOfPoints() != NUM_ELEMENTS * n*n*n)
+  {
+    std::cerr << "order " << order << ": " << output->GetNumberOfPoints() << " points instead of "
+              << NUM_ELEMENTS * n*n*n << "\n";
+    return false;
+  }
+  vtkDataArray* pressure = output->GetPointData()->GetArray("Pressure");
+  vtkIdType i = 0;
+  for(int e=0; e<NUM_ELEMENTS; e++)
+    for(int k=0; k<n; k++)
+      for(int j=0; j<n; j++)
+        for(int l=0; l<n; l++, i++)
+        {
+          double point[3];
+          output->GetPoint(i, point);
+          // the GLL points of orders 1 and 2 are the ends and the middle
+          double expected[3] = { e + double(l)/(n-1), double(j)/(n-1), double(k)/(n-1) };
+          if(std::fabs(point[0] - expected[0]) > TOLERANCE || std::fabs(point[1] - expected[1]) > TOLERANCE ||
+             std::fabs(point[2] - expected[2]) > TOLERANCE ||
+             std::fabs(pressure->GetTuple1(i) - pressureAt(point[0], point[1], point[2])) > 100.0 * TOLERANCE)
+          {
+            std::cerr << "order " << order << ": point " << i << " (" << point[0] << ", " << point[1] << ", "
+                      << point[2] << ") of pressure " << pressure->GetTuple1(i) << "\n";
+            return false;
+          }
+          bool corner = (l == 0 || l == n-1) && (j == 0 || j == n-1) && (k == 0 || k == n-1);
+          int corner_index = ((k ? ORDER-1 : 0) * ORDER + (j ? ORDER-1 : 0)) * ORDER + (l ? ORDER-1 : 0);
+          if(corner && !samePoint(output, i, full, e * BLOCK_SIZE + corner_index, TOLERANCE))
+          {
+            std::cerr << "order " << order << ": wrong corner\n";
+            return false;
+          }
+        }
+  return true;
+}
+
+int main(int, char**)
+{
+  std::string prefix = "TestReaderProjection";
+  if(!writeDataset(prefix))
+  {
+    std::cerr << "cannot write " << prefix << "\n";
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+  vtkNew<vtkNek5000Reader> reader;
+  vtkUnstructuredGrid* full = readPressure(reader, prefix);
+  if(!full || full->GetNumberOfPoints() != NUM_ELEMENTS * BLOCK_SIZE)
+  {
+    std::cerr << "expected " << NUM_ELEMENTS * BLOCK_SIZE << " points in a full read\n";
+    status = EXIT_FAILURE;
+  }
+  else if(!checkProjection(prefix, full, 1) || !checkProjection(prefix, full, 2))
+  {
+    status = EXIT_FAILURE;
+  }
+
+  removeDataset(prefix);
+  return status;
+}
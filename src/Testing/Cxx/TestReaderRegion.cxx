@@ -0,0 +1,97 @@
+// Read a dataset with a RegionOfInterest, a box then a slab: only the
+// elements intersecting the region must be output, with the points of a full
+// read. The bounds of the elements are saved next to the dataset; they must
+// not be used once the mesh is written again, even within the same second.
+
+#include "TestReaderDataset.h"
+
+#include "vtkNew.h"
+
+#include <cstdlib>
+#include <vector>
+
+// 'output' holds the points of the 'elements' of 'full', in this order
+static bool checkRegion(vtkUnstructuredGrid* output, vtkUnstructuredGrid* full, const std::vector<int>& elements,
+                        const char* what)
+{
+  if(!output || output->GetNumberOfPoints() != vtkIdType(elements.size()) * BLOCK_SIZE)
+  {
+    std::cerr << what << ": " << (output ? output->GetNumberOfPoints() : 0) << " points instead of "
+              << elements.size() * BLOCK_SIZE << "\n";
+    return false;
+  }
+  for(size_t e=0; e<elements.size(); e++)
+  {
+    for(vtkIdType p=0; p<BLOCK_SIZE; p++)
+    {
+      if(!samePoint(output, e * BLOCK_SIZE + p, full, elements[e] * BLOCK_SIZE + p))
+      {
+        std::cerr << what << ": wrong point of element " << elements[e] << "\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool checkBox(const std::string& prefix, vtkUnstructuredGrid* full, double x0, double x1,
+                     const std::vector<int>& elements)
+{
+  vtkNew<vtkNek5000Reader> reader;
+  double bounds[6] = { x0, x1, -10.0, 10.0, -10.0, 10.0 };
+  reader->SetRegionOfInterest(1);
+  reader->SetRegionBounds(bounds);
+  return checkRegion(readPressure(reader, prefix), full, elements, "box");
+}
+
+int main(int, char**)
+{
+  std::string prefix = "TestReaderRegion";
+  if(!writeDataset(prefix))
+  {
+    std::cerr << "cannot write " << prefix << "\n";
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+  vtkNew<vtkNek5000Reader> reader;
+  vtkUnstructuredGrid* full = readPressure(reader, prefix);
+  if(!full || full->GetNumberOfPoints() != NUM_ELEMENTS * BLOCK_SIZE)
+  {
+    std::cerr << "expected " << NUM_ELEMENTS * BLOCK_SIZE << " points in a full read\n";
+    status = EXIT_FAILURE;
+  }
+  else
+  {
+    // element e covers [e, e+1] along x; the second read uses the bounds saved
+    if(!checkBox(prefix, full, 1.2, 2.8, { 1, 2 }) || !checkBox(prefix, full, 2.2, 2.8, { 2 }))
+      status = EXIT_FAILURE;
+
+    vtkNew<vtkNek5000Reader> slab;
+    double origin[3] = { 3.5, 0.0, 0.0 }, normal[3] = { 1.0, 0.0, 0.0 };
+    slab->SetRegionOfInterest(2);
+    slab->SetRegionOrigin(origin);
+    slab->SetRegionNormal(normal);
+    slab->SetRegionThickness(0.2);
+    if(!checkRegion(readPressure(slab, prefix), full, { 3 }, "slab"))
+      status = EXIT_FAILURE;
+  }
+
+  // the odd elements moved by 1, in a data file of the same size: element 1
+  // now covers [2, 3] too
+  if(status == EXIT_SUCCESS && !writeDataset(prefix, 1.0))
+  {
+    std::cerr << "cannot write " << prefix << " again\n";
+    status = EXIT_FAILURE;
+  }
+  if(status == EXIT_SUCCESS)
+  {
+    vtkNew<vtkNek5000Reader> moved;
+    full = readPressure(moved, prefix);
+    if(!full || !checkBox(prefix, full, 2.2, 2.8, { 1, 2 }))
+      status = EXIT_FAILURE;
+  }
+
+  removeDataset(prefix);
+  return status;
+}
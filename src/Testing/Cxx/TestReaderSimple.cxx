@@ -26,6 +26,19 @@ vtkIONek5000CxxTests(int argc, char **argv)
   std::string filein;
   std::string varname;
   bool AnimateAlltimeSteps = false;
+  bool UseMemoryMap = false;
+  bool DoublePrecision = false;
+  int PrefetchDepth = 0;
+  bool FastOpen = false;
+  bool GeometryCache = false;
+  bool LowMemory = false;
+  bool HighOrderCells = false;
+  int ElementStride = 1;
+  int ProjectionOrder = 0;
+  std::vector<double> RegionBox;
+  std::vector<double> RegionSlab;
+  std::string ValueArrayName;
+  std::vector<double> ValueRange;
   double TimeStep = 0.0;
   int k, BlockIndex = 0;
 
@@ -39,6 +52,32 @@ vtkIONek5000CxxTests(int argc, char **argv)
     "-step", vtksys::CommandLineArguments::SPACE_ARGUMENT, &TimeStep, "(show a particular time step)");
   args.AddArgument(
     "-animate", vtksys::CommandLineArguments::NO_ARGUMENT, &AnimateAlltimeSteps, "(animate all steps)");
+  args.AddArgument(
+    "-mmap", vtksys::CommandLineArguments::NO_ARGUMENT, &UseMemoryMap, "(memory-map the data files)");
+  args.AddArgument(
+    "-double", vtksys::CommandLineArguments::NO_ARGUMENT, &DoublePrecision, "(keep the double precision of 8-byte files)");
+  args.AddArgument(
+    "-prefetch", vtksys::CommandLineArguments::SPACE_ARGUMENT, &PrefetchDepth, "(number of steps read ahead when animating)");
+  args.AddArgument(
+    "-fast", vtksys::CommandLineArguments::NO_ARGUMENT, &FastOpen, "(read only the first and last step headers when opening)");
+  args.AddArgument(
+    "-geomcache", vtksys::CommandLineArguments::NO_ARGUMENT, &GeometryCache, "(save the geometry next to the dataset, or map it if saved before)");
+  args.AddArgument(
+    "-lowmem", vtksys::CommandLineArguments::NO_ARGUMENT, &LowMemory, "(keep a single copy of each field and of the geometry)");
+  args.AddArgument(
+    "-lagrange", vtksys::CommandLineArguments::NO_ARGUMENT, &HighOrderCells, "(one Lagrange cell per spectral element)");
+  args.AddArgument(
+    "-stride", vtksys::CommandLineArguments::SPACE_ARGUMENT, &ElementStride, "(read every n-th point of the elements in each direction, 0 for their corners)");
+  args.AddArgument(
+    "-order", vtksys::CommandLineArguments::SPACE_ARGUMENT, &ProjectionOrder, "(interpolate the elements to this lower polynomial order)");
+  args.AddArgument(
+    "-box", vtksys::CommandLineArguments::MULTI_ARGUMENT, &RegionBox, "(read only the elements in the box xmin xmax ymin ymax zmin zmax)");
+  args.AddArgument(
+    "-slab", vtksys::CommandLineArguments::MULTI_ARGUMENT, &RegionSlab, "(read only the elements in the slab of origin x y z, normal x y z and thickness t)");
+  args.AddArgument(
+    "-valuearray", vtksys::CommandLineArguments::SPACE_ARGUMENT, &ValueArrayName, "(output only the elements where this scalar has values in -valuerange)");
+  args.AddArgument(
+    "-valuerange", vtksys::CommandLineArguments::MULTI_ARGUMENT, &ValueRange, "(the min and max of the values of interest, equal for an isovalue)");
 
   if ( !args.Parse() || argc == 1 || filein.empty())
     {
@@ -57,6 +96,33 @@ vtkIONek5000CxxTests(int argc, char **argv)
   vtkNew<vtkNek5000Reader> reader;
   reader->DebugOff();
   reader->SetFileName(filein.c_str());
+  reader->SetFastOpen(FastOpen);
+  reader->SetUseMemoryMap(UseMemoryMap);
+  reader->SetDoublePrecision(DoublePrecision);
+  reader->SetPrefetchDepth(PrefetchDepth);
+  reader->SetGeometryCache(GeometryCache);
+  reader->SetLowMemory(LowMemory);
+  reader->SetHighOrderCells(HighOrderCells);
+  reader->SetElementStride(ElementStride);
+  reader->SetProjectionOrder(ProjectionOrder);
+  if(RegionBox.size() == 6)
+    {
+    reader->SetRegionOfInterest(1);
+    reader->SetRegionBounds(RegionBox.data());
+    }
+  else if(RegionSlab.size() == 7)
+    {
+    reader->SetRegionOfInterest(2);
+    reader->SetRegionOrigin(RegionSlab.data());
+    reader->SetRegionNormal(RegionSlab.data() + 3);
+    reader->SetRegionThickness(RegionSlab[6]);
+    }
+  if(!ValueArrayName.empty() && ValueRange.size() == 2)
+    {
+    reader->SetValueOfInterest(1);
+    reader->SetValueArrayName(ValueArrayName.c_str());
+    reader->SetValueRange(ValueRange.data());
+    }
   reader->UpdateInformation();
   reader->DisableAllPointArrays();
   reader->SetPointArrayStatus(varname.c_str(), 1);
@@ -70,6 +136,10 @@ vtkIONek5000CxxTests(int argc, char **argv)
     reader->GetOutput()->GetPointData()->GetScalars(varname.c_str())->GetRange(range);
     cerr << varname.c_str() << ": scalar range = [" << range[0] << ", " << range[1] << "]\n";
     }
+  cerr << "I/O: " << reader->GetNumberOfBytesRead() << " bytes in "
+       << reader->GetNumberOfReadRequests() << " read requests (vs. "
+       << reader->GetNumberOfPerElementReadRequests() << " with one request per element)\n";
+  cerr << "memory: " << reader->GetPeakMemoryBytes() << " bytes at most\n";
 
 #ifdef WITH_GRAPHICS
 
@@ -129,6 +199,10 @@ vtkIONek5000CxxTests(int argc, char **argv)
           renWin->Render();
           }
         delete [] TimeSteps;
+        cerr << "prefetch: " << reader->GetNumberOfPrefetchHits() << " hits, "
+             << reader->GetNumberOfPrefetchMisses() << " misses\n";
+        cerr << "cache: " << reader->GetNumberOfCachedSteps() << " steps, "
+             << reader->GetCacheResidentBytes() << " bytes\n";
 	}
     }
   iren->Start();
@@ -0,0 +1,84 @@
+// Read a dataset with an ElementStride, from a file and from a mapping: the
+// points kept of each element, every stride-th one with the last, must be
+// those of a full read, in the same order.
+
+#include "TestReaderDataset.h"
+
+#include "vtkNew.h"
+
+#include <cstdlib>
+#include <vector>
+
+// the points kept per direction with 'stride'
+static std::vector<int> keptPoints(int stride)
+{
+  int step = (stride == 0) ? ORDER-1 : stride;
+  std::vector<int> kept;
+  for(int i=0; i<ORDER-1; i += step)
+    kept.push_back(i);
+  kept.push_back(ORDER-1);
+  return kept;
+}
+
+static bool checkStride(const std::string& prefix, vtkUnstructuredGrid* full, int stride, int use_mmap)
+{
+  vtkNew<vtkNek5000Reader> reader;
+  reader->SetElementStride(stride);
+  reader->SetUseMemoryMap(use_mmap);
+  vtkUnstructuredGrid* output = readPressure(reader, prefix);
+  if(!output)
+    return false;
+
+  std::vector<int> kept = keptPoints(stride);
+  vtkIdType n = static_cast<vtkIdType>(kept.size());
+  if(output->GetNumberOfPoints() != NUM_ELEMENTS * n*n*n)
+  {
+    std::cerr << "stride " << stride << ": " << output->GetNumberOfPoints() << " points instead of "
+              << NUM_ELEMENTS * n*n*n << "\n";
+    return false;
+  }
+  vtkIdType i = 0;
+  for(int e=0; e<NUM_ELEMENTS; e++)
+    for(int k : kept)
+      for(int j : kept)
+        for(int l : kept)
+        {
+          if(!samePoint(output, i++, full, e * BLOCK_SIZE + (k * ORDER + j) * ORDER + l))
+          {
+            std::cerr << "stride " << stride << (use_mmap ? ", mapped" : "") << ": wrong point\n";
+            return false;
+          }
+        }
+  return true;
+}
+
+int main(int, char**)
+{
+  std::string prefix = "TestReaderStride";
+  if(!writeDataset(prefix))
+  {
+    std::cerr << "cannot write " << prefix << "\n";
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+  vtkNew<vtkNek5000Reader> reader;
+  vtkUnstructuredGrid* full = readPressure(reader, prefix);
+  if(!full || full->GetNumberOfPoints() != NUM_ELEMENTS * BLOCK_SIZE)
+  {
+    std::cerr << "expected " << NUM_ELEMENTS * BLOCK_SIZE << " points in a full read\n";
+    status = EXIT_FAILURE;
+  }
+  else
+  {
+    for(int use_mmap=0; use_mmap<2; use_mmap++)
+    {
+      if(!checkStride(prefix, full, 2, use_mmap) || !checkStride(prefix, full, 3, use_mmap) ||
+         !checkStride(prefix, full, 0, use_mmap))
+        status = EXIT_FAILURE;
+    }
+  }
+
+  removeDataset(prefix);
+  return status;
+}
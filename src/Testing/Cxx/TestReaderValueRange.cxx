@@ -0,0 +1,86 @@
+// Read a dataset with a ValueOfInterest: only the cells of the elements whose
+// pressure has values within the ValueRange must be output, those of a full
+// read, and the points must be left as they are.
+
+#include "TestReaderDataset.h"
+
+#include "vtkIdList.h"
+#include "vtkNew.h"
+
+#include <cstdlib>
+#include <vector>
+
+static bool checkRange(const std::string& prefix, vtkUnstructuredGrid* full, double v0, double v1,
+                       const std::vector<int>& elements)
+{
+  vtkNew<vtkNek5000Reader> reader;
+  double range[2] = { v0, v1 };
+  reader->SetValueOfInterest(1);
+  reader->SetValueArrayName("Pressure");
+  reader->SetValueRange(range);
+  vtkUnstructuredGrid* output = readPressure(reader, prefix);
+  if(!output)
+    return false;
+
+  vtkIdType cells_per_element = full->GetNumberOfCells() / NUM_ELEMENTS;
+  if(output->GetNumberOfPoints() != full->GetNumberOfPoints() ||
+     output->GetNumberOfCells() != vtkIdType(elements.size()) * cells_per_element)
+  {
+    std::cerr << "range [" << v0 << ", " << v1 << "]: " << output->GetNumberOfPoints() << " points and "
+              << output->GetNumberOfCells() << " cells instead of " << full->GetNumberOfPoints() << " and "
+              << elements.size() * cells_per_element << "\n";
+    return false;
+  }
+  for(vtkIdType i=0; i<output->GetNumberOfPoints(); i++)
+  {
+    if(!samePoint(output, i, full, i))
+      return false;
+  }
+  vtkNew<vtkIdList> cell, full_cell;
+  for(size_t e=0; e<elements.size(); e++)
+  {
+    for(vtkIdType c=0; c<cells_per_element; c++)
+    {
+      output->GetCellPoints(e * cells_per_element + c, cell);
+      full->GetCellPoints(elements[e] * cells_per_element + c, full_cell);
+      bool same = (cell->GetNumberOfIds() == full_cell->GetNumberOfIds());
+      for(vtkIdType p=0; same && p<cell->GetNumberOfIds(); p++)
+        same = (cell->GetId(p) == full_cell->GetId(p));
+      if(!same)
+      {
+        std::cerr << "range [" << v0 << ", " << v1 << "]: cell " << c << " of element " << elements[e]
+                  << " differs from a full read\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int, char**)
+{
+  std::string prefix = "TestReaderValueRange";
+  if(!writeDataset(prefix))
+  {
+    std::cerr << "cannot write " << prefix << "\n";
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+  vtkNew<vtkNek5000Reader> reader;
+  vtkUnstructuredGrid* full = readPressure(reader, prefix);
+  if(!full || full->GetNumberOfPoints() != NUM_ELEMENTS * BLOCK_SIZE || full->GetNumberOfCells() == 0)
+  {
+    std::cerr << "expected " << NUM_ELEMENTS * BLOCK_SIZE << " points in a full read\n";
+    status = EXIT_FAILURE;
+  }
+  // the pressure of element e is within [100e + 0.5, 100e + 111.5]
+  else if(!checkRange(prefix, full, 150.0, 160.0, { 1 }) || !checkRange(prefix, full, 205.0, 205.0, { 1, 2 }) ||
+          !checkRange(prefix, full, 0.0, 1000.0, { 0, 1, 2, 3 }) || !checkRange(prefix, full, 500.0, 600.0, {}))
+  {
+    status = EXIT_FAILURE;
+  }
+
+  removeDataset(prefix);
+  return status;
+}